@@ -0,0 +1,258 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "AdaptiveTimer.h"
+#include "Clock.h"
+#include <math.h>
+#include <algorithm>
+
+const int SAMPLE_OPS = 4096;            // ops of a sample window
+const int64_t SAMPLE_MAX_TIME = 5000;   // max time of a sample window in ms
+const int MAX_SAMPLE_DURATIONS = 64;    // max distinct durations counted
+const int MIGRATE_BATCH = 512;          // timers migrated per Update
+const int MAX_DECISIONS = 64;           // decision log length
+
+// cost model, in rough nanoseconds
+const double BASE_OP_COST = 300;        // id lookup and allocation, same for all backends
+const double HEAP_LEVEL_COST = 4;       // one level of heap sift
+const double WHEEL_OP_COST = 10;        // link or unlink at wheel slot
+const double WHEEL_SLOT_COST = 2;       // visit a wheel slot per ms
+const double QUEUE_OP_COST = 60;        // find queue by duration, append or pop
+const double MIGRATE_COST = 300;        // move one timer to new backend
+const double SWITCH_RATIO = 0.75;       // switch only if much cheaper
+const double PAYBACK_WINDOWS = 16;      // migration must pay back in these windows
+
+const int HYBRID_WHEEL_BITS = 14;       // see HybridWheelTimer
+const int HOT_DURATIONS = 16;           // see DurationQueueTimer
+
+static const TimerSchedType Candidates[] = {
+    TimerSchedType::TIMER_DARY_HEAP,
+    TimerSchedType::TIMER_HYBRID_WHEEL,
+    TimerSchedType::TIMER_DURATION_QUEUE,
+};
+
+static int bitLength(uint32_t v)
+{
+    int n = 0;
+    while (v != 0) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
+
+AdaptiveTimer::AdaptiveTimer(TimerSchedType initial)
+{
+    active_ = CreateTimer(initial);
+    sample_.begin_time = Clock::CurrentTimeMillis();
+}
+
+AdaptiveTimer::~AdaptiveTimer()
+{
+    // backends own the wrapper actions only
+    old_.reset();
+    active_.reset();
+}
+
+void AdaptiveTimer::startInner(int timer_id, Entry& entry)
+{
+    entry.owner = active_.get();
+    entry.inner_id = startAtOf(active_.get(), entry.deadline, [this, timer_id]() {
+        fire(timer_id);
+    });
+}
+
+int AdaptiveTimer::add(int64_t deadline, uint32_t duration, TimeoutAction&& action, uint64_t cookie)
+{
+    int id = nextId();
+    Entry& entry = ref_[id];
+    entry.deadline = deadline;
+    entry.cookie = cookie;
+    entry.action = std::move(action);
+    startInner(id, entry);
+
+    sample_.starts++;
+    sample_.duration_hist[bitLength(duration)]++;
+    auto iter = sample_.durations.find(duration);
+    if (iter != sample_.durations.end()) {
+        iter->second++;
+    } else if ((int)sample_.durations.size() < MAX_SAMPLE_DURATIONS) {
+        sample_.durations[duration] = 1;
+    }
+    return id;
+}
+
+int AdaptiveTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, duration, std::move(action), 0);
+}
+
+int AdaptiveTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, duration, nullptr, cookie);
+}
+
+int AdaptiveTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    int64_t now = Clock::CurrentTimeMillis();
+    uint32_t duration = deadline > now ? (uint32_t)(deadline - now) : 0; // sampled only
+    return add(deadline, duration, std::move(action), 0);
+}
+
+bool AdaptiveTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    Entry& entry = iter->second;
+    entry.owner->Cancel(entry.inner_id);
+    ref_.erase(iter);
+    sample_.cancels++;
+    return true;
+}
+
+// called back by backend, collect it and dispatch after backends are done
+void AdaptiveTimer::fire(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return;
+    }
+    Entry& entry = iter->second;
+    collectExpired(timer_id, entry.deadline, entry.cookie, std::move(entry.action));
+    ref_.erase(iter);
+}
+
+int AdaptiveTimer::Update(int64_t now)
+{
+    int fired = 0;
+    if (old_ != nullptr) {
+        fired += old_->Update(now);
+    }
+    fired += active_->Update(now);
+    sample_.expires += fired;
+
+    if (old_ != nullptr) {
+        sortExpired(); // timers of both backends
+        migrateBatch();
+    } else {
+        evaluate(Clock::CurrentTimeMillis());
+    }
+    return dispatchExpired();
+}
+
+// estimated cost of heap ops in last sample window,
+// cancel and pop sift down 4 children per level.
+static double heapCost(const AdaptiveSample& sample, double ratio, double levels)
+{
+    return ratio * (sample.starts + sample.cancels * 2 + sample.expires * 4) * levels;
+}
+
+// estimated cost of last sample window if `type` was the backend
+double AdaptiveTimer::estimateCost(TimerSchedType type) const
+{
+    double base = sample_.ops() * BASE_OP_COST;
+    double levels = log2((double)Size() + 2) * HEAP_LEVEL_COST;
+    double starts = sample_.starts > 0 ? sample_.starts : 1;
+    switch (type)
+    {
+    case TimerSchedType::TIMER_HYBRID_WHEEL:
+        {
+            int near = 0;
+            for (int i = 0; i <= HYBRID_WHEEL_BITS; i++) {
+                near += sample_.duration_hist[i];
+            }
+            double ratio = near / starts;
+            double elapsed = (double)(Clock::CurrentTimeMillis() - sample_.begin_time);
+            return base + sample_.ops() * ratio * WHEEL_OP_COST + heapCost(sample_, 1 - ratio, levels) +
+                elapsed * WHEEL_SLOT_COST;
+        }
+    case TimerSchedType::TIMER_DURATION_QUEUE:
+        {
+            std::vector<int> counts;
+            for (auto& kv : sample_.durations) {
+                counts.push_back(kv.second);
+            }
+            std::sort(counts.begin(), counts.end(), std::greater<int>());
+            int hot = 0;
+            int queues = std::min((int)counts.size(), HOT_DURATIONS);
+            for (int i = 0; i < queues; i++) {
+                hot += counts[i];
+            }
+            double ratio = hot / starts;
+            double head_levels = log2((double)queues + 2) * HEAP_LEVEL_COST;
+            return base + sample_.ops() * ratio * QUEUE_OP_COST + heapCost(sample_, 1 - ratio, levels) +
+                sample_.expires * ratio * head_levels;
+        }
+    default:
+        return base + heapCost(sample_, 1, levels);
+    }
+}
+
+void AdaptiveTimer::evaluate(int64_t now)
+{
+    if (sample_.ops() < SAMPLE_OPS && now - sample_.begin_time < SAMPLE_MAX_TIME) {
+        return;
+    }
+    TimerSchedType current = active_->Type();
+    double current_cost = estimateCost(current);
+    TimerSchedType best = current;
+    double best_cost = current_cost;
+    for (auto type : Candidates) {
+        double cost = estimateCost(type);
+        if (cost < best_cost) {
+            best = type;
+            best_cost = cost;
+        }
+    }
+    if (best != current && best_cost < current_cost * SWITCH_RATIO &&
+        (current_cost - best_cost) * PAYBACK_WINDOWS > Size() * MIGRATE_COST) {
+        switchTo(best, now, current_cost, best_cost);
+    }
+    sample_ = AdaptiveSample();
+    sample_.begin_time = now;
+}
+
+void AdaptiveTimer::switchTo(TimerSchedType type, int64_t now, double cost_from, double cost_to)
+{
+    AdaptiveDecision decision;
+    decision.time = now;
+    decision.from = active_->Type();
+    decision.to = type;
+    decision.size = Size();
+    decision.cost_from = cost_from;
+    decision.cost_to = cost_to;
+    if ((int)decisions_.size() >= MAX_DECISIONS) {
+        decisions_.erase(decisions_.begin());
+    }
+    decisions_.push_back(decision);
+
+    old_ = active_;
+    active_ = CreateTimer(type);
+    migrating_.clear();
+    migrating_.reserve(ref_.size());
+    for (auto& kv : ref_) {
+        migrating_.push_back(kv.first);
+    }
+    migrateBatch();
+}
+
+// move a batch of timers from old backend, keep their deadlines
+void AdaptiveTimer::migrateBatch()
+{
+    for (int i = 0; i < MIGRATE_BATCH && !migrating_.empty(); i++) {
+        int id = migrating_.back();
+        migrating_.pop_back();
+        auto iter = ref_.find(id);
+        if (iter == ref_.end() || iter->second.owner != old_.get()) {
+            continue; // fired or canceled
+        }
+        Entry& entry = iter->second;
+        old_->Cancel(entry.inner_id);
+        startInner(id, entry);
+    }
+    if (migrating_.empty()) {
+        old_.reset();
+    }
+}
@@ -0,0 +1,120 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include <vector>
+#include <unordered_map>
+
+// one switch made by AdaptiveTimer
+struct AdaptiveDecision
+{
+    int64_t time = 0;           // when the decision was made
+    TimerSchedType from = TimerSchedType::TIMER_DARY_HEAP;
+    TimerSchedType to = TimerSchedType::TIMER_DARY_HEAP;
+    int size = 0;               // pending timers to migrate
+    double cost_from = 0;       // estimated cost of last sample window
+    double cost_to = 0;
+};
+
+// op mix and duration histogram of a sample window
+struct AdaptiveSample
+{
+    int starts = 0;
+    int cancels = 0;
+    int expires = 0;
+    int64_t begin_time = 0;
+    int duration_hist[33] = {};                     // count by bit length of duration
+    std::unordered_map<uint32_t, int> durations;    // count by exact duration, bounded
+
+    int ops() const { return starts + cancels + expires; }
+};
+
+// timer scheduler which picks its backend by observed workload.
+//
+// the op mix and duration histogram of each sample window feed a cost model of
+// d-ary heap, hybrid wheel and duration queue, when another backend is much cheaper,
+// pending timers are migrated to a new backend a batch per `Update()`,
+// the old backend is drained in the meantime.
+//
+// timer ids are owned by this class, so ids are stable across migration.
+class AdaptiveTimer : public TimerBase
+{
+public:
+    explicit AdaptiveTimer(TimerSchedType initial = TimerSchedType::TIMER_DARY_HEAP);
+    ~AdaptiveTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_ADAPTIVE;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return (int)ref_.size();
+    }
+
+    // type of current backend
+    TimerSchedType ActiveType() const
+    {
+        return active_->Type();
+    }
+
+    // true if pending timers are being migrated
+    bool Migrating() const
+    {
+        return old_ != nullptr;
+    }
+
+    // switches made so far, latest at back
+    const std::vector<AdaptiveDecision>& DecisionLog() const
+    {
+        return decisions_;
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    struct Entry
+    {
+        int64_t deadline = 0;
+        int inner_id = 0;               // id at backend
+        TimerBase* owner = nullptr;     // backend of this timer
+        uint64_t cookie = 0;            // user cookie of poll mode
+        TimeoutAction action = nullptr;
+    };
+
+    int add(int64_t deadline, uint32_t duration, TimeoutAction&& action, uint64_t cookie);
+    void fire(int timer_id);
+    void startInner(int timer_id, Entry& entry);
+
+    void evaluate(int64_t now);
+    double estimateCost(TimerSchedType type) const;
+    void switchTo(TimerSchedType type, int64_t now, double cost_from, double cost_to);
+    void migrateBatch();
+
+private:
+    std::shared_ptr<TimerBase> active_;
+    std::shared_ptr<TimerBase> old_;            // backend being drained
+    std::vector<int> migrating_;                // timers left in old backend
+    std::unordered_map<int, Entry> ref_;        // to make O(1) lookup
+    AdaptiveSample sample_;
+    std::vector<AdaptiveDecision> decisions_;
+};
@@ -0,0 +1,132 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "BufferedHeapTimer.h"
+#include "Clock.h"
+
+BufferedHeapTimer::BufferedHeapTimer(int max_buffer_size)
+    : max_buffer_size_(max_buffer_size)
+{
+    heap_.reserve(64); // reserve a little space
+    buffer_.reserve(64);
+}
+
+BufferedHeapTimer::~BufferedHeapTimer()
+{
+    clear();
+}
+
+void BufferedHeapTimer::clear()
+{
+    for (auto& kv : ref_) {
+        delete kv.second;
+    }
+    ref_.clear();
+    heap_.clear();
+    buffer_.clear();
+    buffer_min_ = INT64_MAX;
+}
+
+// move all buffered timers into heap
+void BufferedHeapTimer::merge()
+{
+    int k = (int)buffer_.size();
+    int n = heap_.size();
+    int levels = 1;
+    for (int m = n; m > 0; m >>= 2) {
+        levels++;
+    }
+    if (k * levels > n + k) {
+        // bulk build is cheaper than pushing one by one
+        auto& nodes = heap_.nodes();
+        for (auto node : buffer_) {
+            node->buffered = false;
+            nodes.push_back(node);
+        }
+        heap_.heapify();
+    } else {
+        for (auto node : buffer_) {
+            node->buffered = false;
+            heap_.push(node);
+        }
+    }
+    buffer_.clear();
+    buffer_min_ = INT64_MAX;
+}
+
+int BufferedHeapTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+{
+    BufferedTimerNode* node = new BufferedTimerNode;
+    node->id = nextId();
+    node->deadline = deadline;
+    node->cookie = cookie;
+    node->action = std::move(action);
+    node->buffered = true;
+    node->index = (int)buffer_.size();
+    buffer_.push_back(node);
+    if (node->deadline < buffer_min_) {
+        buffer_min_ = node->deadline;
+    }
+    ref_[node->id] = node;
+    if ((int)buffer_.size() >= max_buffer_size_) {
+        merge();
+    }
+    return node->id;
+}
+
+int BufferedHeapTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int BufferedHeapTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int BufferedHeapTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+bool BufferedHeapTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    BufferedTimerNode* node = iter->second;
+    ref_.erase(iter);
+    if (node->buffered) {
+        // swap-remove, `buffer_min_` stays as a lower bound
+        BufferedTimerNode* last = buffer_.back();
+        buffer_[node->index] = last;
+        last->index = node->index;
+        buffer_.pop_back();
+        if (buffer_.empty()) {
+            buffer_min_ = INT64_MAX;
+        }
+    } else {
+        heap_.remove(node);
+    }
+    delete node;
+    return true;
+}
+
+int BufferedHeapTimer::Update(int64_t now)
+{
+    if (buffer_min_ <= now) {
+        merge(); // buffer may hold expired timers
+    }
+    while (!heap_.empty()) {
+        BufferedTimerNode* node = heap_.top();
+        if (now < node->deadline || collectStopped()) {
+            break; // no timer expired
+        }
+        heap_.pop();
+        ref_.erase(node->id);
+        collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+        delete node;
+    }
+    return dispatchExpired();
+}
@@ -0,0 +1,95 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include <vector>
+#include <unordered_map>
+
+struct BufferedTimerNode
+{
+    int index = -1;         // array index at heap or buffer
+    bool buffered = false;  // true if in insertion buffer
+    int id = 0;             // unique timer id
+    int64_t deadline = 0;   // expired time in ms
+    uint64_t cookie = 0;    // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+struct BufferedTimerNodeLess
+{
+    bool operator()(const BufferedTimerNode* a, const BufferedTimerNode* b) const
+    {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    }
+};
+
+// timer scheduler implemented by a 4-ary heap with an insertion buffer,
+// for workloads that cancel most timers before they expire.
+//
+// new timers are appended to an unsorted buffer, cancel in buffer is a swap-remove.
+// buffered timers are merged into heap only when `Update()` may need them,
+// i.e. the buffer minimum is due, or when buffer size passes a threshold.
+//
+// complexity:
+//     StartTimer    CancelTimer       PerTick
+//       O(1)      O(1) or O(log N)      O(1)
+//
+class BufferedHeapTimer : public TimerBase
+{
+public:
+    explicit BufferedHeapTimer(int max_buffer_size = 4096);
+    ~BufferedHeapTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_BUFFERED_HEAP;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return (int)ref_.size();
+    }
+
+    // count of timers in insertion buffer
+    int BufferSize() const
+    {
+        return (int)buffer_.size();
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
+    void clear();
+    void merge();
+
+private:
+    DAryHeap<4, BufferedTimerNode, BufferedTimerNodeLess> heap_;
+    std::vector<BufferedTimerNode*> buffer_;            // unsorted insertion buffer
+    std::unordered_map<int, BufferedTimerNode*> ref_;   // to make O(1) lookup
+
+    int64_t buffer_min_ = INT64_MAX;    // lower bound of deadlines in buffer
+    int max_buffer_size_ = 0;
+};
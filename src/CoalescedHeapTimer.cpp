@@ -0,0 +1,126 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "CoalescedHeapTimer.h"
+#include "Clock.h"
+
+static inline CoalescedTimerNode* nodeOf(list_head* entry)
+{
+    return static_cast<CoalescedTimerNode*>(entry);
+}
+
+CoalescedHeapTimer::CoalescedHeapTimer()
+{
+    heap_.reserve(64); // reserve a little space
+}
+
+CoalescedHeapTimer::~CoalescedHeapTimer()
+{
+    clear();
+}
+
+void CoalescedHeapTimer::clear()
+{
+    for (auto& kv : ref_) {
+        delete kv.second;
+    }
+    ref_.clear();
+    for (auto& kv : buckets_) {
+        delete kv.second;
+    }
+    buckets_.clear();
+    for (auto bucket : free_buckets_) {
+        delete bucket;
+    }
+    free_buckets_.clear();
+    heap_.clear();
+}
+
+CoalescedBucket* CoalescedHeapTimer::findOrAddBucket(int64_t deadline)
+{
+    auto iter = buckets_.find(deadline);
+    if (iter != buckets_.end()) {
+        return iter->second;
+    }
+    CoalescedBucket* bucket = nullptr;
+    if (!free_buckets_.empty()) {
+        bucket = free_buckets_.back();
+        free_buckets_.pop_back();
+    } else {
+        bucket = new CoalescedBucket;
+    }
+    bucket->deadline = deadline;
+    INIT_LIST_HEAD(&bucket->timers);
+    heap_.push(bucket);
+    buckets_[deadline] = bucket;
+    return bucket;
+}
+
+void CoalescedHeapTimer::delBucket(CoalescedBucket* bucket)
+{
+    heap_.remove(bucket);
+    buckets_.erase(bucket->deadline);
+    free_buckets_.push_back(bucket);
+}
+
+int CoalescedHeapTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+{
+    CoalescedTimerNode* node = new CoalescedTimerNode;
+    node->id = nextId();
+    node->cookie = cookie;
+    node->action = std::move(action);
+    node->bucket = findOrAddBucket(deadline);
+    list_add_tail(node, &node->bucket->timers);
+    ref_[node->id] = node;
+    return node->id;
+}
+
+int CoalescedHeapTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int CoalescedHeapTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int CoalescedHeapTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+bool CoalescedHeapTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    CoalescedTimerNode* node = iter->second;
+    ref_.erase(iter);
+    __list_del(node->prev, node->next);
+    if (list_empty(&node->bucket->timers)) {
+        delBucket(node->bucket);
+    }
+    delete node;
+    return true;
+}
+
+int CoalescedHeapTimer::Update(int64_t now)
+{
+    while (!heap_.empty()) {
+        CoalescedBucket* bucket = heap_.top();
+        if (now < bucket->deadline || collectStopped()) {
+            break; // no timer expired
+        }
+        CoalescedTimerNode* node = nodeOf(bucket->timers.next);
+        __list_del(node->prev, node->next);
+        if (list_empty(&bucket->timers)) {
+            delBucket(bucket);
+        }
+        ref_.erase(node->id);
+        collectExpired(node->id, bucket->deadline, node->cookie, std::move(node->action));
+        delete node;
+    }
+    return dispatchExpired();
+}
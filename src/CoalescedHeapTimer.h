@@ -0,0 +1,98 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include "list_impl.h"
+#include <vector>
+#include <unordered_map>
+
+// timers which have the same deadline, linked in FIFO order
+struct CoalescedBucket
+{
+    int index = -1;         // array index at heap
+    int64_t deadline = 0;   // expired time in ms
+    list_head timers;
+};
+
+struct CoalescedBucketLess
+{
+    bool operator()(const CoalescedBucket* a, const CoalescedBucket* b) const
+    {
+        return a->deadline < b->deadline;
+    }
+};
+
+// the base list_head is the link in bucket
+struct CoalescedTimerNode : public list_head
+{
+    int id = 0;                         // unique timer id
+    CoalescedBucket* bucket = nullptr;  // bucket of this timer
+    uint64_t cookie = 0;                // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+// timer scheduler implemented by a 4-ary heap of distinct deadlines,
+// timers of the same deadline are coalesced into one bucket,
+// so heap size scales with distinct deadlines instead of timer count,
+// and same deadline timers expire in FIFO order.
+//
+// complexity(M is count of distinct deadlines):
+//     StartTimer    CancelTimer   PerTick
+//      O(log M)      O(log M)       O(1)
+//
+class CoalescedHeapTimer : public TimerBase
+{
+public:
+    CoalescedHeapTimer();
+    ~CoalescedHeapTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_COALESCED_HEAP;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return (int)ref_.size();
+    }
+
+    // count of distinct deadlines
+    int BucketCount() const
+    {
+        return heap_.size();
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
+    void clear();
+
+    CoalescedBucket* findOrAddBucket(int64_t deadline);
+    void delBucket(CoalescedBucket* bucket);
+
+private:
+    DAryHeap<4, CoalescedBucket, CoalescedBucketLess> heap_;
+    std::unordered_map<int64_t, CoalescedBucket*> buckets_;   // deadline to bucket
+    std::unordered_map<int, CoalescedTimerNode*> ref_;         // to make O(1) lookup
+    std::vector<CoalescedBucket*> free_buckets_;               // recycled buckets
+};
@@ -0,0 +1,151 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "CommandQueueTimer.h"
+#include "Clock.h"
+
+enum {
+    CMD_START = 1,
+    CMD_CANCEL = 2,
+};
+
+CommandQueueTimer::CommandQueueTimer(int queue_capacity)
+    : commands_(queue_capacity)
+{
+    heap_.reserve(64); // reserve a little space
+    owner_ = std::this_thread::get_id();
+}
+
+CommandQueueTimer::~CommandQueueTimer()
+{
+    clear();
+}
+
+void CommandQueueTimer::clear()
+{
+    TimerCommand cmd;
+    while (commands_.TryPop(cmd)) {
+    }
+    for (auto& kv : ref_) {
+        delete kv.second;
+    }
+    ref_.clear();
+    heap_.clear();
+}
+
+// atomic min, so a sleeping owner can be woken for an earlier deadline
+void CommandQueueTimer::lowerDeadline(int64_t deadline)
+{
+    int64_t current = next_deadline_.load();
+    while (deadline < current && !next_deadline_.compare_exchange_weak(current, deadline)) {
+    }
+}
+
+void CommandQueueTimer::push(TimerCommand&& cmd)
+{
+    while (!commands_.TryPush(std::move(cmd))) {
+        std::this_thread::yield(); // full, wait for owner to drain
+    }
+}
+
+void CommandQueueTimer::schedule(int id, int64_t deadline, uint64_t cookie, TimeoutAction&& action)
+{
+    CommandTimerNode* node = new CommandTimerNode;
+    node->id = id;
+    node->deadline = deadline;
+    node->cookie = cookie;
+    node->action = std::move(action);
+    heap_.push(node);
+    ref_[id] = node;
+}
+
+int CommandQueueTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+{
+    int id = id_counter_.fetch_add(1, std::memory_order_relaxed);
+    if (isOwner()) {
+        schedule(id, deadline, cookie, std::move(action));
+    } else {
+        TimerCommand cmd;
+        cmd.op = CMD_START;
+        cmd.id = id;
+        cmd.deadline = deadline;
+        cmd.cookie = cookie;
+        cmd.action = std::move(action);
+        push(std::move(cmd));
+    }
+    lowerDeadline(deadline);
+    return id;
+}
+
+int CommandQueueTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int CommandQueueTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int CommandQueueTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+bool CommandQueueTimer::cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    CommandTimerNode* node = iter->second;
+    ref_.erase(iter);
+    heap_.remove(node);
+    delete node;
+    return true;
+}
+
+bool CommandQueueTimer::Cancel(int timer_id)
+{
+    if (isOwner()) {
+        drain(); // the timer may be queued yet
+        return cancel(timer_id);
+    }
+    TimerCommand cmd;
+    cmd.op = CMD_CANCEL;
+    cmd.id = timer_id;
+    push(std::move(cmd));
+    return true;
+}
+
+void CommandQueueTimer::drain()
+{
+    TimerCommand cmd;
+    while (commands_.TryPop(cmd)) {
+        if (cmd.op == CMD_START) {
+            schedule(cmd.id, cmd.deadline, cmd.cookie, std::move(cmd.action));
+        } else {
+            cancel(cmd.id);
+        }
+    }
+}
+
+int CommandQueueTimer::Update(int64_t now)
+{
+    // a producer lowering the deadline after this point keeps its value
+    int64_t published = next_deadline_.load();
+    drain();
+    while (!heap_.empty()) {
+        CommandTimerNode* node = heap_.top();
+        if (now < node->deadline || collectStopped()) {
+            break; // no timer expired
+        }
+        heap_.pop();
+        ref_.erase(node->id);
+        collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+        delete node;
+    }
+    int64_t next = heap_.empty() ? INT64_MAX : heap_.top()->deadline;
+    next_deadline_.compare_exchange_strong(published, next);
+    return dispatchExpired();
+}
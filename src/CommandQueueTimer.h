@@ -0,0 +1,125 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include "MPSCQueue.h"
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+struct CommandTimerNode
+{
+    int index = -1;         // array index at heap
+    int id = 0;             // unique timer id
+    int64_t deadline = 0;   // expired time in ms
+    uint64_t cookie = 0;    // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+struct CommandTimerNodeLess
+{
+    bool operator()(const CommandTimerNode* a, const CommandTimerNode* b) const
+    {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    }
+};
+
+// a Start or Cancel made by non-owner thread
+struct TimerCommand
+{
+    int op = 0;             // CMD_START or CMD_CANCEL
+    int id = 0;
+    int64_t deadline = 0;
+    uint64_t cookie = 0;
+    TimeoutAction action = nullptr;
+};
+
+// timer scheduler owned by one thread, and armed or canceled from any thread.
+//
+// timers live in a 4-ary heap touched by the owner thread only, other threads
+// push Start/Cancel commands into a lock-free MPSC ring which is drained at the start of
+// each `Update()`, ids are allocated atomically so producers get them at once.
+// calls made by the owner thread take effect directly.
+//
+// `NextDeadline()` is readable from any thread, it is a lower bound of pending deadlines,
+// exact after `Update()` if no producer started a timer meanwhile.
+//
+// producers spin when the ring is full, size it for the burst of one update interval.
+class CommandQueueTimer : public TimerBase
+{
+public:
+    explicit CommandQueueTimer(int queue_capacity = 65536);
+    ~CommandQueueTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_COMMAND_QUEUE;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds, from any thread
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`, from any thread
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer from any thread.
+    // a non-owner thread gets true once the command is queued.
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    // drain commands and fire due timers, by owner thread only
+    int Update(int64_t now = 0) override;
+
+    // count of pending timers, by owner thread only
+    int Size() const override
+    {
+        return (int)ref_.size();
+    }
+
+    // deadline of the earliest timer, or -1 if no pending timer
+    int64_t NextDeadline() const override
+    {
+        int64_t deadline = next_deadline_.load();
+        return deadline == INT64_MAX ? -1 : deadline;
+    }
+
+    // make calling thread the owner, the constructing thread by default
+    void BindOwnerThread()
+    {
+        owner_ = std::this_thread::get_id();
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    bool isOwner() const
+    {
+        return std::this_thread::get_id() == owner_;
+    }
+
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
+    void clear();
+    void push(TimerCommand&& cmd);
+    void drain();
+    void schedule(int id, int64_t deadline, uint64_t cookie, TimeoutAction&& action);
+    bool cancel(int timer_id);
+    void lowerDeadline(int64_t deadline);
+
+private:
+    DAryHeap<4, CommandTimerNode, CommandTimerNodeLess> heap_;
+    std::unordered_map<int, CommandTimerNode*> ref_;    // to make O(1) lookup
+    MPSCQueue<TimerCommand> commands_;
+    std::thread::id owner_;
+    std::atomic<int> id_counter_{2020};
+    std::atomic<int64_t> next_deadline_{INT64_MAX};
+};
@@ -0,0 +1,242 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "ConcurrentHashedWheelTimer.h"
+#include "Clock.h"
+#include <thread>
+
+const int WHEEL_SIZE = 1024;        // 1ms per bucket
+const int WHEEL_MASK = WHEEL_SIZE - 1;
+const int PENDING_STACKS = 16;      // producers spread over stacks by thread
+
+enum {
+    STATE_FREE = 0,
+    STATE_PENDING = 1,
+    STATE_CANCELED = 2,
+    STATE_EXPIRED = 3,
+};
+
+static std::atomic<int> stack_counter(0);
+static thread_local int stack_index = -1;
+
+ConcurrentHashedWheelTimer::ConcurrentHashedWheelTimer(int capacity)
+{
+    slot_bits_ = 1;
+    while ((1 << slot_bits_) < capacity) {
+        slot_bits_++;
+    }
+    capacity_ = capacity;
+    gen_mask_ = (1ULL << (31 - slot_bits_)) - 1;
+    slots_.reset(new ConcurrentTimeout[capacity]);
+    ring_mask_ = (1ULL << slot_bits_) - 1;
+    free_ring_.reset(new std::atomic<uint32_t>[ring_mask_ + 1]);
+    for (int i = 0; i < capacity; i++) {
+        slots_[i].tag.store((1ULL << 2) | STATE_FREE, std::memory_order_relaxed);
+        free_ring_[i].store(i, std::memory_order_relaxed);
+    }
+    free_head_.store(0, std::memory_order_relaxed);
+    free_tail_.store(capacity, std::memory_order_relaxed);
+    pending_.reset(new std::atomic<uint32_t>[PENDING_STACKS]);
+    for (int i = 0; i < PENDING_STACKS; i++) {
+        pending_[i].store(0, std::memory_order_relaxed);
+    }
+    bucket_head_.resize(WHEEL_SIZE);
+    bucket_tail_.resize(WHEEL_SIZE);
+    started_at_ = Clock::CurrentTimeMillis();
+}
+
+ConcurrentHashedWheelTimer::~ConcurrentHashedWheelTimer()
+{
+}
+
+// take the oldest free slot, a ring entry read with a stale head is discarded by the failed CAS
+bool ConcurrentHashedWheelTimer::allocSlot(uint32_t& slot)
+{
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    for (;;) {
+        if (head == free_tail_.load(std::memory_order_acquire)) {
+            return false; // all slots in use
+        }
+        slot = free_ring_[head & ring_mask_].load(std::memory_order_relaxed);
+        if (free_head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+// by ticker only, bump generation so stale ids do not match
+void ConcurrentHashedWheelTimer::freeSlot(uint32_t slot)
+{
+    ConcurrentTimeout& timeout = slots_[slot];
+    timeout.action = nullptr;
+    uint64_t gen = (timeout.tag.load(std::memory_order_relaxed) >> 2) + 1;
+    if ((gen & gen_mask_) == 0) {
+        gen++; // keep id non-zero
+    }
+    timeout.tag.store((gen << 2) | STATE_FREE, std::memory_order_relaxed);
+
+    // at most `capacity_` slots are free, a taker still reading the entry at tail has a stale head
+    uint64_t tail = free_tail_.load(std::memory_order_relaxed);
+    free_ring_[tail & ring_mask_].store(slot, std::memory_order_relaxed);
+    free_tail_.store(tail + 1, std::memory_order_release);
+}
+
+int ConcurrentHashedWheelTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+{
+    uint32_t slot = 0;
+    if (!allocSlot(slot)) {
+        return 0;
+    }
+    ConcurrentTimeout& timeout = slots_[slot];
+    timeout.deadline = deadline;
+    timeout.cookie = cookie;
+    timeout.action = std::move(action);
+    uint64_t tag = (timeout.tag.load(std::memory_order_relaxed) & ~3ULL) | STATE_PENDING;
+    timeout.tag.store(tag, std::memory_order_release);
+    size_.fetch_add(1, std::memory_order_relaxed);
+
+    if (stack_index < 0) {
+        stack_index = stack_counter.fetch_add(1, std::memory_order_relaxed) % PENDING_STACKS;
+    }
+    std::atomic<uint32_t>& stack = pending_[stack_index];
+    uint32_t head = stack.load(std::memory_order_relaxed);
+    do {
+        timeout.next = head;
+    } while (!stack.compare_exchange_weak(head, slot + 1, std::memory_order_release, std::memory_order_relaxed));
+    return idOf(slot, tag);
+}
+
+int ConcurrentHashedWheelTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int ConcurrentHashedWheelTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int ConcurrentHashedWheelTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+bool ConcurrentHashedWheelTimer::Cancel(int timer_id)
+{
+    uint32_t slot = (uint32_t)timer_id & ((1u << slot_bits_) - 1);
+    if (timer_id > 0 && (int)slot < capacity_) {
+        uint64_t gen = (uint64_t)timer_id >> slot_bits_;
+        std::atomic<uint64_t>& tag = slots_[slot].tag;
+        uint64_t current = tag.load(std::memory_order_acquire);
+        while (((current >> 2) & gen_mask_) == gen && (current & 3) == STATE_PENDING) {
+            if (tag.compare_exchange_weak(current, (current & ~3ULL) | STATE_CANCELED)) {
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return true; // ticker reaps it later
+            }
+        }
+    }
+    if (std::this_thread::get_id() == ticker_.load(std::memory_order_relaxed)) {
+        return cancelExpired(timer_id); // collected but not dispatched
+    }
+    return false;
+}
+
+void ConcurrentHashedWheelTimer::placeInBucket(uint32_t slot)
+{
+    ConcurrentTimeout& timeout = slots_[slot];
+    if ((timeout.tag.load(std::memory_order_acquire) & 3) != STATE_PENDING) {
+        freeSlot(slot); // canceled before placed
+        return;
+    }
+    int64_t tick = timeout.deadline - started_at_;
+    if (tick < tick_) {
+        tick = tick_;
+    }
+    timeout.rounds = (int)((tick - tick_) / WHEEL_SIZE);
+    timeout.next = 0;
+    int idx = (int)(tick & WHEEL_MASK);
+    if (bucket_tail_[idx] == 0) {
+        bucket_head_[idx] = slot + 1;
+    } else {
+        slots_[bucket_tail_[idx] - 1].next = slot + 1;
+    }
+    bucket_tail_[idx] = slot + 1;
+    wheel_count_++;
+}
+
+// take all pending stacks, each reversed to start order
+void ConcurrentHashedWheelTimer::transferPending()
+{
+    for (int i = 0; i < PENDING_STACKS; i++) {
+        uint32_t head = pending_[i].exchange(0, std::memory_order_acquire);
+        uint32_t reversed = 0;
+        while (head != 0) {
+            uint32_t next = slots_[head - 1].next;
+            slots_[head - 1].next = reversed;
+            reversed = head;
+            head = next;
+        }
+        while (reversed != 0) {
+            uint32_t next = slots_[reversed - 1].next;
+            placeInBucket(reversed - 1);
+            reversed = next;
+        }
+    }
+}
+
+void ConcurrentHashedWheelTimer::expireBucket(int64_t tick)
+{
+    int idx = (int)(tick & WHEEL_MASK);
+    uint32_t prev = 0;
+    uint32_t cur = bucket_head_[idx];
+    while (cur != 0) {
+        uint32_t slot = cur - 1;
+        ConcurrentTimeout& timeout = slots_[slot];
+        uint32_t next = timeout.next;
+        uint64_t tag = timeout.tag.load(std::memory_order_acquire);
+        bool remove = true;
+        if ((tag & 3) == STATE_PENDING && timeout.rounds > 0) {
+            timeout.rounds--;
+            remove = false;
+        } else if ((tag & 3) == STATE_PENDING &&
+            timeout.tag.compare_exchange_strong(tag, (tag & ~3ULL) | STATE_EXPIRED)) {
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            collectExpired(idOf(slot, tag), timeout.deadline, timeout.cookie, std::move(timeout.action));
+        }
+        if (remove) {
+            // expired or canceled, unlink and reuse the slot
+            if (prev == 0) {
+                bucket_head_[idx] = next;
+            } else {
+                slots_[prev - 1].next = next;
+            }
+            if (bucket_tail_[idx] == cur) {
+                bucket_tail_[idx] = prev;
+            }
+            wheel_count_--;
+            freeSlot(slot);
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+}
+
+int ConcurrentHashedWheelTimer::Update(int64_t now)
+{
+    ticker_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    int64_t last = now - started_at_; // last tick due
+    while (tick_ <= last) {
+        if (collectStopped()) {
+            break; // resume at this tick
+        }
+        transferPending();
+        if (wheel_count_ == 0) {
+            tick_ = last + 1; // skip empty ticks
+            break;
+        }
+        expireBucket(tick_);
+        tick_++;
+    }
+    return dispatchExpired();
+}
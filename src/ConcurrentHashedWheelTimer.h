@@ -0,0 +1,115 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// a timeout slot of the arena, the memory is never freed while the wheel lives
+struct ConcurrentTimeout
+{
+    std::atomic<uint64_t> tag{0};       // generation << 2 | state
+    uint32_t next = 0;                  // link in pending stack or bucket, slot + 1
+    int rounds = 0;                     // wheel turns left, by ticker only
+    int64_t deadline = 0;
+    uint64_t cookie = 0;
+    TimeoutAction action = nullptr;
+};
+
+// hashed timing wheel which can be armed and canceled from any thread.
+//
+// `Start` takes a slot from a lock-free free ring and CAS pushes it onto one of a few
+// pending stacks picked by thread, `Cancel` is an atomic PENDING->CANCELED transition,
+// like the state machine of Netty's HashedWheelTimeout.
+// a single ticker thread calling `Update()` moves pending timeouts into its private
+// 1ms buckets, fires due ones and reaps canceled ones.
+//
+// timeouts live in a fixed arena of type-stable slots, a timer id carries the slot and
+// its generation, a freed slot bumps its generation and no thread ever touches freed memory.
+// freed slots are reused in FIFO order, so a stale id could only match again after
+// `capacity << generation bits`(2^31) starts, not after a few reuses of a hot slot.
+// `Start` returns 0 and drops the action when all slots are in use.
+//
+// complexity:
+//     StartTimer    CancelTimer   PerTick
+//       O(1)           O(1)         O(1)
+//
+class ConcurrentHashedWheelTimer : public TimerBase
+{
+public:
+    explicit ConcurrentHashedWheelTimer(int capacity = 1 << 20);
+    ~ConcurrentHashedWheelTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds, from any thread,
+    // return 0 if the arena is full
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`, from any thread, return 0 if the arena is full
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer from any thread, fails once the timer is expired
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    // fire due timers, by the ticker thread only
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
+    bool allocSlot(uint32_t& slot);
+    void freeSlot(uint32_t slot);
+    void transferPending();
+    void placeInBucket(uint32_t slot);
+    void expireBucket(int64_t tick);
+
+    int idOf(uint32_t slot, uint64_t tag) const
+    {
+        return (int)((((tag >> 2) & gen_mask_) << slot_bits_) | slot);
+    }
+
+private:
+    std::unique_ptr<ConcurrentTimeout[]> slots_;
+    int capacity_ = 0;
+    int slot_bits_ = 0;
+    uint64_t gen_mask_ = 0;
+    std::unique_ptr<std::atomic<uint32_t>[]> free_ring_; // free slots, pushed by ticker only
+    uint64_t ring_mask_ = 0;
+
+    // contended counters padded apart, `alignas` is not honored by `new` before C++17
+    char pad0_[64 - sizeof(uint64_t)];
+    std::atomic<uint64_t> free_head_{0};                // next to take, by any thread
+    char pad1_[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> free_tail_{0};                // next to put, by ticker
+    char pad2_[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<int> size_{0};
+    char pad3_[64 - sizeof(std::atomic<int>)];
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_;  // stacks of new timeouts, slot + 1
+    std::atomic<std::thread::id> ticker_;               // thread of last `Update()`
+
+    // owned by ticker
+    std::vector<uint32_t> bucket_head_;
+    std::vector<uint32_t> bucket_tail_;
+    int wheel_count_ = 0;
+    int64_t started_at_ = 0;
+    int64_t tick_ = 0;      // next tick to expire
+};
@@ -0,0 +1,149 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include <vector>
+#include "Logging.h"
+
+// d-ary min-heap of node pointers
+// https://en.wikipedia.org/wiki/D-ary_heap
+//
+// node type `T` must have an `int index` member which is maintained by the heap,
+// so a node can be removed or re-positioned in O(log N) without search.
+// `Less` is a strict weak ordering functor over `const T*`.
+//
+// sift routines move a hole instead of swapping, see
+// https://github.com/golang/go/blob/go1.19.10/src/runtime/time.go
+template <int D, typename T, typename Less>
+class DAryHeap
+{
+public:
+    static_assert(D >= 2, "heap arity must be at least 2");
+
+    DAryHeap() = default;
+
+    bool empty() const { return nodes_.empty(); }
+    int size() const { return (int)nodes_.size(); }
+
+    T* top() const { return nodes_[0]; }
+    T* at(int i) const { return nodes_[i]; }
+
+    void reserve(int n) { nodes_.reserve(n); }
+    void clear() { nodes_.clear(); }
+
+    // underlying array, callers may mutate it and call heapify() after
+    std::vector<T*>& nodes() { return nodes_; }
+
+    void push(T* node)
+    {
+        int i = (int)nodes_.size();
+        node->index = i;
+        nodes_.push_back(node);
+        siftup(i);
+    }
+
+    T* pop()
+    {
+        T* node = nodes_[0];
+        removeAt(0);
+        return node;
+    }
+
+    void remove(T* node)
+    {
+        DCHECK(node->index >= 0 && node->index < size() && nodes_[node->index] == node);
+        removeAt(node->index);
+    }
+
+    // re-position `node` after its key changed
+    void fix(T* node)
+    {
+        if (!siftdown(node->index)) {
+            siftup(node->index);
+        }
+    }
+
+    // restore heap order of the whole array in O(N)
+    void heapify()
+    {
+        int n = (int)nodes_.size();
+        for (int i = 0; i < n; i++) {
+            nodes_[i]->index = i;
+        }
+        for (int i = (n - 2) / D; i >= 0; i--) {
+            siftdown(i);
+        }
+    }
+
+private:
+    void removeAt(int i)
+    {
+        int last = (int)nodes_.size() - 1;
+        T* node = nodes_[i];
+        if (i != last) {
+            nodes_[i] = nodes_[last];
+            nodes_[i]->index = i;
+            nodes_.pop_back();
+            // moving the last node to i may need to go up or down
+            if (!siftdown(i)) {
+                siftup(i);
+            }
+        } else {
+            nodes_.pop_back();
+        }
+        node->index = -1;
+    }
+
+    // moves node at i up toward the top, returns its final index
+    int siftup(int i)
+    {
+        T* node = nodes_[i];
+        while (i > 0) {
+            int p = (i - 1) / D; // parent
+            if (!less_(node, nodes_[p])) {
+                break;
+            }
+            nodes_[i] = nodes_[p];
+            nodes_[i]->index = i;
+            i = p;
+        }
+        nodes_[i] = node;
+        node->index = i;
+        return i;
+    }
+
+    // moves node at x down toward the bottom, returns true if moved
+    bool siftdown(int x)
+    {
+        int n = (int)nodes_.size();
+        int i = x;
+        T* node = nodes_[i];
+        for (;;) {
+            int first = i * D + 1; // first child
+            if (first >= n || first < 0) {
+                break;
+            }
+            int last = first + D < n ? first + D : n;
+            int c = first;
+            for (int j = first + 1; j < last; j++) {
+                if (less_(nodes_[j], nodes_[c])) {
+                    c = j;
+                }
+            }
+            if (!less_(nodes_[c], node)) {
+                break;
+            }
+            nodes_[i] = nodes_[c];
+            nodes_[i]->index = i;
+            i = c;
+        }
+        nodes_[i] = node;
+        node->index = i;
+        return i > x;
+    }
+
+private:
+    std::vector<T*> nodes_;
+    Less less_;
+};
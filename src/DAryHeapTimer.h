@@ -0,0 +1,152 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include "Clock.h"
+#include <unordered_map>
+
+// node layout shared by all arities
+struct DAryHeapNode
+{
+    int index = -1;         // array index at heap
+    int id = 0;             // unique timer id
+    int64_t deadline = 0;   // expired time in ms
+    uint64_t cookie = 0;    // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+// order by deadline, same deadline timers by id, so they expire in FIFO order
+struct DAryHeapNodeLess
+{
+    bool operator()(const DAryHeapNode* a, const DAryHeapNode* b) const
+    {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    }
+};
+
+// timer scheduler implemented by d-ary heap,
+// D = 2 is a binary heap and D = 4 is a quaternary heap.
+//
+// complexity:
+//     StartTimer    CancelTimer       PerTick
+//    O(log_D N)   O(D * log_D N)        O(1)
+//
+template <int D>
+class DAryHeapTimer : public TimerBase
+{
+public:
+    typedef DAryHeap<D, DAryHeapNode, DAryHeapNodeLess> HeapType;
+
+    DAryHeapTimer()
+    {
+        heap_.reserve(64); // reserve a little space
+    }
+
+    ~DAryHeapTimer()
+    {
+        clear();
+    }
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_DARY_HEAP;
+    }
+
+    int Arity() const
+    {
+        return D;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override
+    {
+        return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+    }
+
+    int StartPoll(uint32_t duration, uint64_t cookie) override
+    {
+        return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+    }
+
+    // cancel a timer
+    bool Cancel(int timer_id) override
+    {
+        auto iter = ref_.find(timer_id);
+        if (iter == ref_.end()) {
+            return cancelExpired(timer_id);
+        }
+        DAryHeapNode* node = iter->second;
+        heap_.remove(node);
+        ref_.erase(iter);
+        delete node;
+        return true;
+    }
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override
+    {
+        while (!heap_.empty()) {
+            DAryHeapNode* node = heap_.top();
+            if (now < node->deadline || collectStopped()) {
+                break; // no timer expired
+            }
+            heap_.pop();
+            ref_.erase(node->id);
+            collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+            delete node;
+        }
+        return dispatchExpired();
+    }
+
+    int Size() const override
+    {
+        return heap_.size();
+    }
+
+    // deadline of the earliest timer, or -1 if no pending timer
+    int64_t NextDeadline() const override
+    {
+        return heap_.empty() ? -1 : heap_.top()->deadline;
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override
+    {
+        return add(deadline, std::move(action), 0);
+    }
+
+private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+    {
+        DAryHeapNode* node = new DAryHeapNode;
+        node->id = nextId();
+        node->deadline = deadline;
+        node->cookie = cookie;
+        node->action = std::move(action);
+        heap_.push(node);
+        ref_[node->id] = node;
+        return node->id;
+    }
+
+    void clear()
+    {
+        for (auto& kv : ref_) {
+            delete kv.second;
+        }
+        ref_.clear();
+        heap_.clear();
+    }
+
+private:
+    HeapType heap_;
+    std::unordered_map<int, DAryHeapNode*> ref_; // to make O(1) lookup
+};
@@ -0,0 +1,191 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "DAryHeap.h"
+#include "Clock.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// blocking queue of delayed items, like Java's `DelayQueue`
+// see https://github.com/openjdk/jdk/blob/jdk-17%2B35/src/java.base/share/classes/java/util/concurrent/DelayQueue.java
+//
+// items are kept in a 4-ary heap ordered by deadline, consumer threads `Take()` the
+// earliest item once it is due.
+// with leader-follower, only one consumer(the leader) does a timed wait on the head
+// deadline, others wait until signaled. a leader taking an item signals one follower to
+// become the next leader, a new head item signals one consumer, so a due item wakes
+// one thread instead of all of them.
+template <typename T>
+class DelayQueue
+{
+public:
+    // `leader_follower` of false makes every consumer wait on the head deadline,
+    // and every new head wake all of them.
+    explicit DelayQueue(bool leader_follower = true)
+        : leader_follower_(leader_follower)
+    {
+        heap_.reserve(64); // reserve a little space
+    }
+
+    ~DelayQueue()
+    {
+        for (auto& kv : ref_) {
+            delete kv.second;
+        }
+    }
+
+    DelayQueue(const DelayQueue&) = delete;
+    DelayQueue& operator=(const DelayQueue&) = delete;
+
+    // put an item which is due after `delay` milliseconds, returns id of the item
+    int Put(uint32_t delay, T item)
+    {
+        Node* node = new Node;
+        node->deadline = Clock::CurrentTimeMillis() + (int64_t)delay;
+        node->item = std::move(item);
+
+        std::lock_guard<std::mutex> guard(mutex_);
+        node->id = next_id_++;
+        heap_.push(node);
+        ref_[node->id] = node;
+        if (heap_.top() == node) {
+            // head changed, current leader waits for a wrong deadline
+            if (leader_follower_) {
+                leader_ = std::thread::id();
+                available_.notify_one();
+            } else {
+                available_.notify_all();
+            }
+        }
+        return node->id;
+    }
+
+    // remove an item not taken yet
+    bool Remove(int id)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto iter = ref_.find(id);
+        if (iter == ref_.end()) {
+            return false;
+        }
+        Node* node = iter->second;
+        ref_.erase(iter);
+        heap_.remove(node);
+        delete node;
+        return true;
+    }
+
+    // take the earliest item, blocking until it is due.
+    // return false once the queue is closed
+    bool Take(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool taken = false;
+        std::thread::id self = std::this_thread::get_id();
+        while (!closed_) {
+            if (heap_.empty()) {
+                available_.wait(lock);
+                wakeups_++;
+                continue;
+            }
+            int64_t delay = heap_.top()->deadline - Clock::CurrentTimeMillis();
+            if (delay <= 0) {
+                popTop(item);
+                taken = true;
+                break;
+            }
+            if (leader_follower_ && leader_ != std::thread::id()) {
+                available_.wait(lock); // follower
+                wakeups_++;
+                continue;
+            }
+            leader_ = self;
+            available_.wait_for(lock, std::chrono::milliseconds(delay));
+            wakeups_++;
+            if (leader_ == self) {
+                leader_ = std::thread::id();
+            }
+        }
+        if (leader_follower_ && leader_ == std::thread::id() && !heap_.empty()) {
+            available_.notify_one(); // hand over to next leader
+        }
+        return taken;
+    }
+
+    // take the earliest item if it is due, never block
+    bool Poll(T& item)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (heap_.empty() || heap_.top()->deadline > Clock::CurrentTimeMillis()) {
+            return false;
+        }
+        popTop(item);
+        return true;
+    }
+
+    // wake all consumers, `Take()` returns false afterwards
+    void Close()
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        closed_ = true;
+        available_.notify_all();
+    }
+
+    int Size() const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return heap_.size();
+    }
+
+    // count of consumer wakeups, signaled or timed out
+    int64_t Wakeups() const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return wakeups_;
+    }
+
+private:
+    struct Node
+    {
+        int index = -1;         // array index at heap
+        int id = 0;
+        int64_t deadline = 0;   // due time in ms
+        T item;
+    };
+
+    // same deadline items by id, so they are taken in FIFO order
+    struct NodeLess
+    {
+        bool operator()(const Node* a, const Node* b) const
+        {
+            if (a->deadline == b->deadline) {
+                return a->id < b->id;
+            }
+            return a->deadline < b->deadline;
+        }
+    };
+
+    void popTop(T& item)
+    {
+        Node* node = heap_.pop();
+        ref_.erase(node->id);
+        item = std::move(node->item);
+        delete node;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    DAryHeap<4, Node, NodeLess> heap_;
+    std::unordered_map<int, Node*> ref_;    // to make O(1) lookup
+    std::thread::id leader_;                // consumer waiting on head deadline
+    bool leader_follower_ = true;
+    bool closed_ = false;
+    int next_id_ = 2020;
+    int64_t wakeups_ = 0;
+};
@@ -0,0 +1,251 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "DurationQueueTimer.h"
+#include "Clock.h"
+
+const int MIN_RING_SIZE = 16;
+const int HOT_DURATION_STARTS = 32;     // starts to promote a duration to hot
+const int MAX_DURATION_QUEUES = 16;     // max count of hot durations
+const int MAX_DURATION_SAMPLES = 1024;  // max distinct durations counted
+
+void DurationQueue::push(DurationTimerNode* node)
+{
+    int size = (int)ring.size();
+    if (count == size) {
+        int new_size = size < MIN_RING_SIZE ? MIN_RING_SIZE : size * 2;
+        std::vector<DurationTimerNode*> new_ring(new_size);
+        for (int i = 0; i < count; i++) {
+            new_ring[i] = ring[(head + i) & (size - 1)];
+        }
+        ring.swap(new_ring);
+        head = 0;
+        size = new_size;
+    }
+    node->seq = head_seq + count;
+    ring[(head + count) & (size - 1)] = node;
+    count++;
+}
+
+DurationTimerNode* DurationQueue::pop()
+{
+    int mask = (int)ring.size() - 1;
+    DurationTimerNode* node = ring[head];
+    ring[head] = nullptr;
+    head = (head + 1) & mask;
+    head_seq++;
+    count--;
+    while (count > 0 && ring[head] == nullptr) {
+        head = (head + 1) & mask;
+        head_seq++;
+        count--;
+        dead--;
+    }
+    return node;
+}
+
+void DurationQueue::erase(DurationTimerNode* node)
+{
+    if (node == front()) {
+        pop();
+        return;
+    }
+    int mask = (int)ring.size() - 1;
+    int pos = (int)(node->seq - head_seq);
+    ring[(head + pos) & mask] = nullptr;
+    if (pos < count - 1) {
+        dead++;
+        return;
+    }
+    count--;
+    while (back() == nullptr) {
+        count--;
+        dead--;
+    }
+}
+
+void DurationQueue::compact()
+{
+    int mask = (int)ring.size() - 1;
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        DurationTimerNode* node = ring[(head + i) & mask];
+        if (node != nullptr) {
+            ring[(head + i) & mask] = nullptr;
+            node->seq = head_seq + n;
+            ring[(head + n) & mask] = node;
+            n++;
+        }
+    }
+    count = n;
+    dead = 0;
+}
+
+DurationQueueTimer::DurationQueueTimer()
+{
+}
+
+DurationQueueTimer::~DurationQueueTimer()
+{
+    clear();
+}
+
+void DurationQueueTimer::clear()
+{
+    for (auto& kv : ref_) {
+        delete kv.second;
+    }
+    for (auto& kv : queues_) {
+        delete kv.second;
+    }
+    queues_.clear();
+    fallback_.clear();
+    heads_.clear();
+    ref_.clear();
+}
+
+void DurationQueueTimer::RegisterDuration(uint32_t duration)
+{
+    if (queues_.count(duration) > 0) {
+        return;
+    }
+    DurationQueue* queue = new DurationQueue;
+    queue->duration = duration;
+    queues_[duration] = queue;
+    start_counts_.erase(duration);
+}
+
+DurationQueue* DurationQueueTimer::findQueue(uint32_t duration)
+{
+    auto iter = queues_.find(duration);
+    if (iter != queues_.end()) {
+        return iter->second;
+    }
+    if ((int)queues_.size() >= MAX_DURATION_QUEUES) {
+        return nullptr;
+    }
+    if ((int)start_counts_.size() >= MAX_DURATION_SAMPLES) {
+        start_counts_.clear(); // durations are too scattered, sample again
+    }
+    if (++start_counts_[duration] >= HOT_DURATION_STARTS) {
+        RegisterDuration(duration);
+        return queues_[duration];
+    }
+    return nullptr;
+}
+
+// re-position queue at head heap after its front changed
+void DurationQueueTimer::repositionQueue(DurationQueue* queue)
+{
+    if (queue->empty()) {
+        if (queue->index >= 0) {
+            heads_.remove(queue);
+        }
+    } else {
+        if (queue->index >= 0) {
+            heads_.fix(queue);
+        } else {
+            heads_.push(queue);
+        }
+    }
+}
+
+int DurationQueueTimer::add(int64_t deadline, uint32_t duration, TimeoutAction&& action, uint64_t cookie)
+{
+    DurationTimerNode* node = new DurationTimerNode;
+    node->id = nextId();
+    node->deadline = deadline;
+    node->cookie = cookie;
+    node->action = std::move(action);
+
+    DurationQueue* queue = findQueue(duration);
+    // clock may go backwards, keep the queue sorted
+    if (queue != nullptr && (queue->empty() || queue->back()->deadline <= node->deadline)) {
+        node->queue = queue;
+        queue->push(node);
+        if (queue->count == 1) {
+            heads_.push(queue);
+        }
+    } else {
+        fallback_.push(node);
+    }
+    ref_[node->id] = node;
+    return node->id;
+}
+
+int DurationQueueTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, duration, std::move(action), 0);
+}
+
+int DurationQueueTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, duration, nullptr, cookie);
+}
+
+int DurationQueueTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    int64_t now = Clock::CurrentTimeMillis();
+    uint32_t duration = deadline > now ? (uint32_t)(deadline - now) : 0; // picks a queue only
+    return add(deadline, duration, std::move(action), 0);
+}
+
+bool DurationQueueTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    DurationTimerNode* node = iter->second;
+    ref_.erase(iter);
+    DurationQueue* queue = node->queue;
+    if (queue == nullptr) {
+        fallback_.remove(node);
+    } else {
+        bool is_front = (queue->front() == node);
+        queue->erase(node);
+        if (is_front) {
+            repositionQueue(queue);
+        } else if (queue->dead > MIN_RING_SIZE && queue->dead * 2 > queue->count) {
+            queue->compact();
+        }
+    }
+    delete node;
+    return true;
+}
+
+DurationTimerNode* DurationQueueTimer::earliest() const
+{
+    DurationTimerNode* node = nullptr;
+    if (!heads_.empty()) {
+        node = heads_.top()->front();
+    }
+    if (!fallback_.empty()) {
+        DurationTimerNode* other = fallback_.top();
+        if (node == nullptr || DurationTimerNodeLess()(other, node)) {
+            node = other;
+        }
+    }
+    return node;
+}
+
+int DurationQueueTimer::Update(int64_t now)
+{
+    while (true) {
+        DurationTimerNode* node = earliest();
+        if (node == nullptr || now < node->deadline || collectStopped()) {
+            break; // no timer expired
+        }
+        DurationQueue* queue = node->queue;
+        if (queue != nullptr) {
+            queue->pop();
+            repositionQueue(queue);
+        } else {
+            fallback_.pop();
+        }
+        ref_.erase(node->id);
+        collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+        delete node;
+    }
+    return dispatchExpired();
+}
@@ -0,0 +1,138 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include <vector>
+#include <unordered_map>
+
+struct DurationQueue;
+
+struct DurationTimerNode
+{
+    int index = -1;                 // array index at fallback heap
+    int id = 0;                     // unique timer id
+    int64_t seq = 0;                // sequence number in queue
+    int64_t deadline = 0;           // expired time in ms
+    DurationQueue* queue = nullptr; // owner queue, null if in fallback heap
+    uint64_t cookie = 0;            // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+struct DurationTimerNodeLess
+{
+    bool operator()(const DurationTimerNode* a, const DurationTimerNode* b) const
+    {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    }
+};
+
+// timers of one fixed duration, deadlines are appended in monotone order
+// so a FIFO ring buffer is already sorted.
+// canceled timers leave a null hole in ring, front and back are never null.
+struct DurationQueue
+{
+    int index = -1;             // array index at head heap
+    uint32_t duration = 0;
+    int dead = 0;               // count of holes
+    std::vector<DurationTimerNode*> ring;   // capacity is power of 2
+    int head = 0;
+    int count = 0;              // count of slots, including holes
+    int64_t head_seq = 0;       // sequence number of ring[head]
+
+    DurationTimerNode* front() const { return ring[head]; }
+    DurationTimerNode* back() const { return ring[(head + count - 1) & (ring.size() - 1)]; }
+    bool empty() const { return count == 0; }
+
+    void push(DurationTimerNode* node);
+    DurationTimerNode* pop();
+
+    // make a hole for canceled `node`, drop holes at both ends
+    void erase(DurationTimerNode* node);
+
+    // remove all holes in O(n)
+    void compact();
+};
+
+// order queues by their head timer
+struct DurationQueueLess
+{
+    bool operator()(const DurationQueue* a, const DurationQueue* b) const
+    {
+        return DurationTimerNodeLess()(a->front(), b->front());
+    }
+};
+
+// timer scheduler for constant-timeout workloads.
+// timers of hot durations are appended to per-duration FIFO queues with O(1) insert,
+// a small heap over queue heads drives expiry, other durations fall back to a 4-ary heap.
+// hot durations are registered by `RegisterDuration()` or detected by start frequency.
+//
+// complexity(Q is count of hot durations):
+//          StartTimer    CancelTimer   PerTick
+//   hot      O(log Q)       O(1)         O(1)
+//   other    O(log N)     O(log N)       O(1)
+//
+class DurationQueueTimer : public TimerBase
+{
+public:
+    DurationQueueTimer();
+    ~DurationQueueTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_DURATION_QUEUE;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return (int)ref_.size();
+    }
+
+    // use a FIFO queue for timers of `duration`
+    void RegisterDuration(uint32_t duration);
+
+    // count of hot durations
+    int QueueCount() const
+    {
+        return (int)queues_.size();
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    int add(int64_t deadline, uint32_t duration, TimeoutAction&& action, uint64_t cookie);
+    void clear();
+
+    DurationQueue* findQueue(uint32_t duration);
+    void repositionQueue(DurationQueue* queue);
+    DurationTimerNode* earliest() const;
+
+private:
+    DAryHeap<4, DurationQueue, DurationQueueLess> heads_;           // non-empty queues
+    DAryHeap<4, DurationTimerNode, DurationTimerNodeLess> fallback_;  // timers of other durations
+    std::unordered_map<uint32_t, DurationQueue*> queues_;           // hot durations
+    std::unordered_map<uint32_t, int> start_counts_;                // to detect hot durations
+    std::unordered_map<int, DurationTimerNode*> ref_;               // to make O(1) lookup
+};
@@ -0,0 +1,213 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#if defined(__linux__)
+
+#include "EventLoop.h"
+#include "Clock.h"
+#include "Logging.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+const int MAX_EVENTS = 64;
+
+EventLoop::EventLoop(std::shared_ptr<TimerBase> timer, LoopTimerMode mode)
+    : timer_(timer), mode_(mode)
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        LOG(FATAL) << "create epoll or eventfd: " << strerror(errno);
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    if (mode_ == LoopTimerMode::TimerFd) {
+        // deadlines are milliseconds of system clock
+        timer_fd_ = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd_ < 0) {
+            LOG(FATAL) << "create timerfd: " << strerror(errno);
+        }
+        ev.data.fd = timer_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev);
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    if (timer_fd_ >= 0) {
+        close(timer_fd_);
+    }
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+void EventLoop::Run()
+{
+    while (!stop_.load(std::memory_order_relaxed)) {
+        RunOnce(-1);
+    }
+    stop_ = false;
+}
+
+void EventLoop::Stop()
+{
+    stop_ = true;
+    Post(nullptr); // wake up the loop
+}
+
+void EventLoop::Post(TimeoutAction action)
+{
+    {
+        std::lock_guard<std::mutex> guard(post_mutex_);
+        posted_.push_back(std::move(action));
+    }
+    if (!wake_pending_.exchange(true)) {
+        uint64_t one = 1;
+        ssize_t n = write(wake_fd_, &one, sizeof(one));
+        (void)n;
+        writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int EventLoop::Start(uint32_t duration, TimeoutAction action)
+{
+    return timer_->Start(duration, std::move(action)); // timerfd is re-armed before next wait
+}
+
+bool EventLoop::Cancel(int timer_id)
+{
+    return timer_->Cancel(timer_id);
+}
+
+bool EventLoop::AddFd(int fd, uint32_t events, IOCallback callback)
+{
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        LOG(ERROR) << "add fd " << fd << ": " << strerror(errno);
+        return false;
+    }
+    callbacks_[fd] = std::move(callback);
+    return true;
+}
+
+bool EventLoop::RemoveFd(int fd)
+{
+    if (callbacks_.erase(fd) == 0) {
+        return false;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    return true;
+}
+
+EventLoopStats EventLoop::Stats() const
+{
+    EventLoopStats stats = stats_;
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// INT64_MAX if no pending timer
+int64_t EventLoop::nextWake() const
+{
+    int64_t deadline = timer_->NextDeadline();
+    if (deadline >= 0) {
+        return deadline;
+    }
+    if (timer_->Size() == 0) {
+        return INT64_MAX;
+    }
+    return Clock::CurrentTimeMillis() + 1; // not tracked, tick every 1ms
+}
+
+// arm the timerfd to next deadline if it changed, returns timeout of epoll_wait
+int EventLoop::armTimer()
+{
+    int64_t deadline = nextWake();
+    if (mode_ == LoopTimerMode::WaitTimeout) {
+        if (deadline == INT64_MAX) {
+            return -1;
+        }
+        int64_t delay = deadline - Clock::CurrentTimeMillis();
+        return delay > 0 ? (int)std::min<int64_t>(delay, INT32_MAX) : 0;
+    }
+    if (deadline != armed_) {
+        struct itimerspec spec = {};
+        if (deadline != INT64_MAX) {
+            spec.it_value.tv_sec = deadline / 1000;
+            spec.it_value.tv_nsec = (deadline % 1000) * 1000000;
+        }
+        timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr); // zero value disarms
+        stats_.arms++;
+        armed_ = deadline;
+    }
+    return -1;
+}
+
+void EventLoop::drainTimer()
+{
+    uint64_t expirations = 0;
+    ssize_t n = read(timer_fd_, &expirations, sizeof(expirations));
+    (void)n;
+    stats_.reads++;
+    armed_ = INT64_MAX; // an absolute timer is disarmed once expired
+}
+
+void EventLoop::runPosted()
+{
+    uint64_t count = 0;
+    ssize_t n = read(wake_fd_, &count, sizeof(count));
+    (void)n;
+    stats_.reads++;
+    wake_pending_ = false; // posts after this write the eventfd again
+
+    std::vector<TimeoutAction> actions;
+    {
+        std::lock_guard<std::mutex> guard(post_mutex_);
+        actions.swap(posted_);
+    }
+    for (auto& action : actions) {
+        if (action) {
+            action();
+            stats_.posted++;
+        }
+    }
+}
+
+void EventLoop::RunOnce(int max_wait_ms)
+{
+    int timeout = armTimer();
+    if (max_wait_ms >= 0 && (timeout < 0 || timeout > max_wait_ms)) {
+        timeout = max_wait_ms;
+    }
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+    stats_.polls++;
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == timer_fd_) {
+            drainTimer();
+        } else if (fd == wake_fd_) {
+            runPosted();
+        } else {
+            auto iter = callbacks_.find(fd);
+            if (iter != callbacks_.end()) {
+                IOCallback callback = iter->second; // may remove itself
+                callback(events[i].events);
+            }
+        }
+    }
+    if (timer_->Size() > 0) {
+        stats_.fired += timer_->Update(Clock::CurrentTimeMillis());
+    }
+}
+
+#endif // __linux__
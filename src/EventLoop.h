@@ -0,0 +1,110 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#if defined(__linux__)
+
+#include "TimerBase.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// callback of a readiness event, `events` is the epoll event mask
+typedef std::function<void(uint32_t events)> IOCallback;
+
+// how the loop waits for next deadline
+enum class LoopTimerMode
+{
+    TimerFd,        // a single timerfd armed to absolute deadline, ns precision
+    WaitTimeout,    // timeout argument of epoll_wait, ms precision but no extra syscall
+};
+
+// counters of a loop, updated by the loop thread
+struct EventLoopStats
+{
+    int64_t polls = 0;      // epoll_wait calls
+    int64_t arms = 0;       // timerfd_settime calls
+    int64_t reads = 0;      // read of timerfd or eventfd
+    int64_t writes = 0;     // write to eventfd, by posting threads
+    int64_t fired = 0;      // fired timers
+    int64_t posted = 0;     // run posted functors
+
+    int64_t Syscalls() const
+    {
+        return polls + arms + reads + writes;
+    }
+};
+
+// an epoll event loop owning a scheduler, timers and I/O callbacks run on the loop thread.
+//
+// the loop waits on the earliest deadline of the scheduler, through a single timerfd or
+// the epoll_wait timeout. the timerfd is re-armed only when the deadline changes,
+// so timers started behind the head cost no syscall. a scheduler not tracking
+// `NextDeadline()` is ticked every 1ms while it has pending timers.
+//
+// `Start`, `Cancel`, `AddFd` and `RemoveFd` must be called on the loop thread(or before `Run`),
+// other threads hand work over by `Post`, which wakes the loop through an eventfd
+// written only once per batch.
+class EventLoop
+{
+public:
+    explicit EventLoop(std::shared_ptr<TimerBase> timer, LoopTimerMode mode = LoopTimerMode::TimerFd);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // run on calling thread until `Stop()`
+    void Run();
+
+    // run one iteration, wait at most `max_wait_ms` milliseconds, -1 to wait for next event
+    void RunOnce(int max_wait_ms = -1);
+
+    // make `Run()` return, from any thread
+    void Stop();
+
+    // run `action` on the loop thread, from any thread
+    void Post(TimeoutAction action);
+
+    int Start(uint32_t duration, TimeoutAction action);
+    bool Cancel(int timer_id);
+
+    // watch a file descriptor, `events` is an epoll event mask like EPOLLIN
+    bool AddFd(int fd, uint32_t events, IOCallback callback);
+    bool RemoveFd(int fd);
+
+    int Size() const
+    {
+        return timer_->Size();
+    }
+
+    // counters, exact once the loop is stopped
+    EventLoopStats Stats() const;
+
+private:
+    int64_t nextWake() const;
+    int armTimer();
+    void drainTimer();
+    void runPosted();
+
+private:
+    std::shared_ptr<TimerBase> timer_;
+    LoopTimerMode mode_ = LoopTimerMode::TimerFd;
+    int epoll_fd_ = -1;
+    int timer_fd_ = -1;
+    int wake_fd_ = -1;
+    int64_t armed_ = INT64_MAX;         // deadline the timerfd is armed to
+    std::unordered_map<int, IOCallback> callbacks_;
+    std::atomic<bool> stop_{false};
+
+    std::mutex post_mutex_;
+    std::vector<TimeoutAction> posted_;     // under `post_mutex_`
+    std::atomic<bool> wake_pending_{false}; // eventfd written and not read yet
+    std::atomic<int64_t> writes_{0};
+    EventLoopStats stats_;
+};
+
+#endif // __linux__
@@ -0,0 +1,390 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "GoTimerHeap.h"
+#include "Clock.h"
+#include "Logging.h"
+#include <algorithm>
+#include <thread>
+
+const int SLOT_BITS = 20;                       // at most 1M timers
+const int CHUNK_BITS = 10;                      // slots per arena chunk
+const int CHUNK_SIZE = 1 << CHUNK_BITS;
+const int MAX_CHUNKS = 1 << (SLOT_BITS - CHUNK_BITS);
+const uint64_t GEN_MASK = (1ULL << (63 - SLOT_BITS)) - 1;  // id is a positive int64_t
+
+// timer states, see comments of `timerWaiting` etc. in Go runtime
+enum {
+    TIMER_FREE = 0,             // not in use
+    TIMER_WAITING = 1,          // in heap, waiting for its time
+    TIMER_MODIFYING = 2,        // being modified by `Cancel` or `Reset`, briefly
+    TIMER_MODIFIED_EARLIER = 3, // in heap, `nextwhen` is before `when`
+    TIMER_MODIFIED_LATER = 4,   // in heap, `nextwhen` is after `when`
+    TIMER_DELETED = 5,          // in heap, canceled
+    TIMER_RUNNING = 6,          // popped to run, briefly
+    TIMER_MOVING = 7,           // being moved to `nextwhen` by heap owner, briefly
+};
+
+static std::atomic<int> thread_counter(0);
+static thread_local int thread_index = -1;
+
+static int threadIndex()
+{
+    if (thread_index < 0) {
+        thread_index = thread_counter.fetch_add(1, std::memory_order_relaxed) & INT_MAX;
+    }
+    return thread_index;
+}
+
+static inline uint64_t genOf(uint64_t status)
+{
+    return status >> 3;
+}
+
+static inline int stateOf(uint64_t status)
+{
+    return (int)(status & 7);
+}
+
+static inline uint64_t withState(uint64_t status, int state)
+{
+    return (status & ~7ULL) | (uint64_t)state;
+}
+
+GoTimerHeap::GoTimerHeap(int heaps)
+{
+    if (heaps == 0) {
+        heaps = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    if (heaps < 1) {
+        LOG(FATAL) << "invalid heap count: " << heaps;
+    }
+    for (int i = 0; i < heaps; i++) {
+        heaps_.emplace_back(new TimerHeap);
+        heaps_.back()->heap.reserve(64); // reserve a little space
+    }
+    chunks_.reset(new std::atomic<GoTimer*>[MAX_CHUNKS]);
+    for (int i = 0; i < MAX_CHUNKS; i++) {
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+GoTimerHeap::~GoTimerHeap()
+{
+    for (int i = 0; i < chunk_count_; i++) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+}
+
+GoTimer* GoTimerHeap::slotAt(uint32_t slot) const
+{
+    GoTimer* chunk = chunks_[slot >> CHUNK_BITS].load(std::memory_order_acquire);
+    return chunk != nullptr ? &chunk[slot & (CHUNK_SIZE - 1)] : nullptr;
+}
+
+GoTimer* GoTimerHeap::slotOf(int64_t timer_id) const
+{
+    if (timer_id <= 0) {
+        return nullptr;
+    }
+    return slotAt((uint32_t)(timer_id & ((1 << SLOT_BITS) - 1)));
+}
+
+// allocate a chunk of slots and push them to free list
+void GoTimerHeap::grow()
+{
+    std::lock_guard<std::mutex> guard(grow_mutex_);
+    if ((uint32_t)free_head_.load(std::memory_order_acquire) != 0) {
+        return; // grown by another thread
+    }
+    if (chunk_count_ == MAX_CHUNKS) {
+        LOG(FATAL) << "too many timers: " << (MAX_CHUNKS << CHUNK_BITS);
+    }
+    uint32_t base = (uint32_t)chunk_count_ << CHUNK_BITS;
+    GoTimer* chunk = new GoTimer[CHUNK_SIZE];
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        chunk[i].status.store((1ULL << 3) | TIMER_FREE, std::memory_order_relaxed);
+        chunk[i].next_free.store(i + 1 < CHUNK_SIZE ? base + i + 2 : 0, std::memory_order_relaxed);
+    }
+    chunks_[chunk_count_++].store(chunk, std::memory_order_release);
+
+    // splice the chunk onto free list
+    GoTimer* last = &chunk[CHUNK_SIZE - 1];
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    for (;;) {
+        last->next_free.store((uint32_t)head, std::memory_order_relaxed);
+        uint64_t desired = (((head >> 32) + 1) << 32) | (base + 1);
+        if (free_head_.compare_exchange_weak(head, desired, std::memory_order_release)) {
+            break;
+        }
+    }
+}
+
+// pop free list, the ABA counter guards against a slot popped and pushed back meanwhile
+uint32_t GoTimerHeap::allocSlot()
+{
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t first = (uint32_t)head;
+        if (first == 0) {
+            grow();
+            head = free_head_.load(std::memory_order_acquire);
+            continue;
+        }
+        uint32_t next = slotAt(first - 1)->next_free.load(std::memory_order_relaxed);
+        uint64_t desired = (((head >> 32) + 1) << 32) | next;
+        if (free_head_.compare_exchange_weak(head, desired, std::memory_order_acquire)) {
+            return first - 1;
+        }
+    }
+}
+
+// by heap owner only, bump generation so stale ids never match
+void GoTimerHeap::freeSlot(GoTimer* t)
+{
+    t->action = nullptr;
+    uint64_t gen = genOf(t->status.load(std::memory_order_relaxed)) + 1;
+    if ((gen & GEN_MASK) == 0) {
+        gen++; // keep id non-zero
+    }
+    t->status.store((gen << 3) | TIMER_FREE, std::memory_order_release);
+
+    uint32_t slot = (uint32_t)(t->id & ((1 << SLOT_BITS) - 1));
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    for (;;) {
+        t->next_free.store((uint32_t)head, std::memory_order_relaxed);
+        uint64_t desired = (((head >> 32) + 1) << 32) | (slot + 1);
+        if (free_head_.compare_exchange_weak(head, desired, std::memory_order_release)) {
+            break;
+        }
+    }
+}
+
+// by heap owner only
+void GoTimerHeap::publish(TimerHeap& h)
+{
+    int64_t when = h.heap.empty() ? INT64_MAX : h.heap.top()->when;
+    h.timer0_when.store(when, std::memory_order_release);
+}
+
+int64_t GoTimerHeap::Start(uint32_t duration, TimeoutAction action)
+{
+    uint32_t slot = allocSlot();
+    GoTimer* t = slotAt(slot);
+    uint64_t status = withState(t->status.load(std::memory_order_relaxed), TIMER_WAITING);
+    int index = threadIndex() % (int)heaps_.size();
+    t->id = (int64_t)(((genOf(status) & GEN_MASK) << SLOT_BITS) | slot);
+    t->when = Clock::CurrentTimeMillis() + (int64_t)duration;
+    t->action = std::move(action);
+    t->heap.store(index, std::memory_order_relaxed);
+    int64_t id = t->id;
+
+    TimerHeap& h = *heaps_[index];
+    std::lock_guard<std::mutex> guard(h.mutex);
+    t->status.store(status, std::memory_order_release);
+    h.heap.push(t);
+    if (h.heap.top() == t) {
+        publish(h);
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+bool GoTimerHeap::Cancel(int64_t timer_id)
+{
+    GoTimer* t = slotOf(timer_id);
+    if (t == nullptr) {
+        return false;
+    }
+    uint64_t gen = (uint64_t)timer_id >> SLOT_BITS;
+    for (;;) {
+        uint64_t status = t->status.load(std::memory_order_acquire);
+        if ((genOf(status) & GEN_MASK) != gen) {
+            return false;
+        }
+        int heap = t->heap.load(std::memory_order_relaxed); // valid if CAS below succeeds
+        switch (stateOf(status)) {
+        case TIMER_WAITING:
+        case TIMER_MODIFIED_EARLIER:
+        case TIMER_MODIFIED_LATER:
+            if (t->status.compare_exchange_weak(status, withState(status, TIMER_DELETED),
+                std::memory_order_acq_rel)) {
+                heaps_[heap]->deleted.fetch_add(1, std::memory_order_relaxed);
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            break;
+        case TIMER_MODIFYING:
+        case TIMER_MOVING:
+            std::this_thread::yield(); // wait for the other change
+            break;
+        default:
+            return false; // deleted, running or freed
+        }
+    }
+}
+
+bool GoTimerHeap::Reset(int64_t timer_id, uint32_t duration)
+{
+    GoTimer* t = slotOf(timer_id);
+    if (t == nullptr) {
+        return false;
+    }
+    int64_t nextwhen = Clock::CurrentTimeMillis() + (int64_t)duration;
+    uint64_t gen = (uint64_t)timer_id >> SLOT_BITS;
+    uint64_t status = 0;
+    for (;;) {
+        status = t->status.load(std::memory_order_acquire);
+        if ((genOf(status) & GEN_MASK) != gen) {
+            return false;
+        }
+        int state = stateOf(status);
+        if (state == TIMER_WAITING || state == TIMER_MODIFIED_EARLIER || state == TIMER_MODIFIED_LATER) {
+            if (t->status.compare_exchange_weak(status, withState(status, TIMER_MODIFYING),
+                std::memory_order_acq_rel)) {
+                break;
+            }
+        } else if (state == TIMER_MODIFYING || state == TIMER_MOVING) {
+            std::this_thread::yield();
+        } else {
+            return false;
+        }
+    }
+    // own the timer until status is stored back
+    t->nextwhen = nextwhen;
+    int state = nextwhen < t->when ? TIMER_MODIFIED_EARLIER : TIMER_MODIFIED_LATER;
+    TimerHeap& h = *heaps_[t->heap.load(std::memory_order_relaxed)];
+    t->status.store(withState(status, state), std::memory_order_release);
+    if (state == TIMER_MODIFIED_EARLIER) {
+        // the heap owner must look before `when`
+        int64_t earliest = h.modified_earliest.load(std::memory_order_relaxed);
+        while (nextwhen < earliest && !h.modified_earliest.compare_exchange_weak(earliest, nextwhen)) {
+        }
+    }
+    return true;
+}
+
+bool GoTimerHeap::ripe(const TimerHeap& h, int64_t now) const
+{
+    return h.timer0_when.load(std::memory_order_acquire) <= now ||
+        h.modified_earliest.load(std::memory_order_acquire) <= now;
+}
+
+// move all modified timers to their new deadline, like `adjusttimers` in Go runtime
+void GoTimerHeap::adjustTimers(TimerHeap& h)
+{
+    h.modified_earliest.store(INT64_MAX, std::memory_order_relaxed);
+    std::vector<GoTimer*>& nodes = h.heap.nodes();
+    bool moved = false;
+    for (GoTimer* t : nodes) {
+        uint64_t status = t->status.load(std::memory_order_acquire);
+        int state = stateOf(status);
+        if ((state == TIMER_MODIFIED_EARLIER || state == TIMER_MODIFIED_LATER) &&
+            t->status.compare_exchange_strong(status, withState(status, TIMER_MOVING),
+                std::memory_order_acq_rel)) {
+            t->when = t->nextwhen;
+            t->status.store(withState(status, TIMER_WAITING), std::memory_order_release);
+            moved = true;
+        }
+    }
+    if (moved) {
+        h.heap.heapify();
+    }
+}
+
+// drop all deleted timers in one pass, like `clearDeletedTimers` in Go runtime
+void GoTimerHeap::clearDeleted(TimerHeap& h)
+{
+    std::vector<GoTimer*>& nodes = h.heap.nodes();
+    int live = 0;
+    int cleared = 0;
+    for (GoTimer* t : nodes) {
+        if (stateOf(t->status.load(std::memory_order_acquire)) == TIMER_DELETED) {
+            t->index = -1;
+            freeSlot(t); // deleted is final, no one else changes it
+            cleared++;
+        } else {
+            nodes[live++] = t;
+        }
+    }
+    nodes.resize(live);
+    h.heap.heapify();
+    h.deleted.fetch_sub(cleared, std::memory_order_relaxed);
+}
+
+// run due timers of a heap, callbacks run after unlock
+int GoTimerHeap::runHeap(TimerHeap& h, int64_t now, bool steal)
+{
+    if (!ripe(h, now)) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(h.mutex, std::defer_lock);
+    if (steal) {
+        if (!lock.try_lock()) {
+            return 0; // run by its owner
+        }
+    } else {
+        lock.lock();
+    }
+    if (h.modified_earliest.load(std::memory_order_acquire) <= now) {
+        adjustTimers(h);
+    }
+    if (h.deleted.load(std::memory_order_relaxed) > h.heap.size() / 4) {
+        clearDeleted(h);
+    }
+    std::vector<TimeoutAction> actions;
+    while (!h.heap.empty()) {
+        GoTimer* t = h.heap.top();
+        uint64_t status = t->status.load(std::memory_order_acquire);
+        int state = stateOf(status);
+        if (state == TIMER_WAITING) {
+            if (now < t->when) {
+                break;
+            }
+            if (!t->status.compare_exchange_strong(status, withState(status, TIMER_RUNNING),
+                std::memory_order_acq_rel)) {
+                continue; // canceled or reset meanwhile
+            }
+            h.heap.pop();
+            actions.push_back(std::move(t->action));
+            freeSlot(t);
+            size_.fetch_sub(1, std::memory_order_relaxed);
+        } else if (state == TIMER_DELETED) {
+            h.heap.pop();
+            h.deleted.fetch_sub(1, std::memory_order_relaxed);
+            freeSlot(t);
+        } else if (state == TIMER_MODIFIED_EARLIER || state == TIMER_MODIFIED_LATER) {
+            if (t->status.compare_exchange_strong(status, withState(status, TIMER_MOVING),
+                std::memory_order_acq_rel)) {
+                t->when = t->nextwhen;
+                h.heap.fix(t);
+                t->status.store(withState(status, TIMER_WAITING), std::memory_order_release);
+            }
+        } else {
+            std::this_thread::yield(); // being modified by another thread
+        }
+    }
+    publish(h);
+    lock.unlock();
+    for (auto& action : actions) {
+        if (action) {
+            action();
+        }
+    }
+    return (int)actions.size();
+}
+
+int GoTimerHeap::Update(int64_t now)
+{
+    int n = (int)heaps_.size();
+    int own = threadIndex() % n;
+    int fired = runHeap(*heaps_[own], now, false);
+    if (fired > 0) {
+        return fired;
+    }
+    // idle, steal due timers of other heaps
+    for (int i = 1; i < n; i++) {
+        fired += runHeap(*heaps_[(own + i) % n], now, true);
+    }
+    return fired;
+}
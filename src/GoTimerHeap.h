@@ -0,0 +1,116 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// a timer slot of the arena, the memory is never freed while the heap lives
+struct GoTimer
+{
+    std::atomic<uint64_t> status{0};    // generation << 3 | state
+    std::atomic<uint32_t> next_free{0}; // link in free list, slot + 1
+    std::atomic<int> heap{0};           // owning heap, set at start
+    int index = -1;                     // array index at heap
+    int64_t id = 0;
+    int64_t when = 0;                   // heap key, written by heap owner
+    int64_t nextwhen = 0;               // deadline set by `Reset()`
+    TimeoutAction action = nullptr;
+};
+
+struct GoTimerLess
+{
+    bool operator()(const GoTimer* a, const GoTimer* b) const
+    {
+        if (a->when == b->when) {
+            return a->id < b->id;
+        }
+        return a->when < b->when;
+    }
+};
+
+// per-thread 4-ary timer heaps with the timer status machine of Go runtime
+// see https://github.com/golang/go/blob/go1.19.10/src/runtime/time.go
+//
+// a thread starts timers on its own heap, `Cancel` and `Reset` from any thread only flip
+// the status of a timer atomically (waiting -> deleted, waiting -> modifiedEarlier/Later),
+// the thread running a heap applies these in batch at `Update()`, popping deleted timers
+// and moving modified ones to their new deadline.
+// a thread with nothing due on its own heap steals due timers of other heaps.
+//
+// timers live in a type-stable arena, a 64-bit timer id carries the slot and a 43-bit
+// generation, so a stale id never matches a reused slot.
+class GoTimerHeap
+{
+public:
+    // `heaps` of 0 means one per hardware thread
+    explicit GoTimerHeap(int heaps = 0);
+    ~GoTimerHeap();
+
+    GoTimerHeap(const GoTimerHeap&) = delete;
+    GoTimerHeap& operator=(const GoTimerHeap&) = delete;
+
+    // start a timer after `duration` milliseconds on heap of calling thread
+    int64_t Start(uint32_t duration, TimeoutAction action);
+
+    // cancel a timer from any thread
+    bool Cancel(int64_t timer_id);
+
+    // move a pending timer to fire after `duration` milliseconds from now, from any thread.
+    // return false if the timer is fired or canceled
+    bool Reset(int64_t timer_id, uint32_t duration);
+
+    // run due timers of heap of calling thread, or steal from other heaps if none.
+    // return number of fired timers
+    int Update(int64_t now);
+
+    // count of pending timers
+    int Size() const
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    int HeapCount() const
+    {
+        return (int)heaps_.size();
+    }
+
+private:
+    // padded at tail so heaps allocated by `new` share no line, `alignas` needs C++17 `new`
+    struct TimerHeap
+    {
+        std::atomic<int64_t> timer0_when{INT64_MAX};        // when of heap top
+        std::atomic<int64_t> modified_earliest{INT64_MAX};  // earliest of modifiedEarlier timers
+        std::atomic<int> deleted{0};                        // count of deleted timers in heap
+        std::mutex mutex;
+        DAryHeap<4, GoTimer, GoTimerLess> heap;
+        char pad[64];
+    };
+
+    GoTimer* slotAt(uint32_t slot) const;
+    GoTimer* slotOf(int64_t timer_id) const;
+    uint32_t allocSlot();
+    void grow();
+    void freeSlot(GoTimer* t);
+    bool ripe(const TimerHeap& h, int64_t now) const;
+    int runHeap(TimerHeap& h, int64_t now, bool steal);
+    void adjustTimers(TimerHeap& h);
+    void clearDeleted(TimerHeap& h);
+    void publish(TimerHeap& h);
+
+private:
+    std::vector<std::unique_ptr<TimerHeap>> heaps_;
+    std::unique_ptr<std::atomic<GoTimer*>[]> chunks_;   // arena grown by chunk
+    int chunk_count_ = 0;                               // under `grow_mutex_`
+    std::mutex grow_mutex_;
+    char pad0_[64];
+    std::atomic<uint64_t> free_head_{0};                // ABA counter << 32 | slot + 1
+    char pad1_[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<int> size_{0};
+    char pad2_[64 - sizeof(std::atomic<int>)];
+};
@@ -6,6 +6,8 @@
 #include "Logging.h"
 #include <assert.h>
 
+const int64_t BOUNDED_TICK_STEP = 64;   // ticks walked between budget checks
+
 inline int64_t current_clock() {
     return Clock::CurrentTimeMillis();
 }
@@ -34,27 +36,45 @@ void HHWheelTimer::clear()
 }
 
 
-int HHWheelTimer::Start(uint32_t duration, TimeoutAction action)
+int HHWheelTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
 {
     int id = nextId();
     timer_list* timer = new timer_list();
     timer->id = id;
     timer->base = &base_;
     timer->data = this;
-    timer->expires = Clock::CurrentTimeMillis() + (int64_t)duration;
+    timer->expires = deadline;
+    timer->cookie = cookie;
     timer->function = HHWheelTimer::handleTimerExpired;
 
     add_timer(timer);
     ref_[id] = timer;
-    actions_[id] = action;
+    if (action) {
+        actions_[id] = std::move(action);
+    }
     return id;
 }
 
+int HHWheelTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int HHWheelTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int HHWheelTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
 bool HHWheelTimer::Cancel(int timer_id)
 {
     auto iter = ref_.find(timer_id);
     if (iter == ref_.end()) {
-        return false;
+        return cancelExpired(timer_id);
     }
 
     timer_list* timer = iter->second;
@@ -71,7 +91,16 @@ bool HHWheelTimer::Cancel(int timer_id)
 
 int HHWheelTimer::Update(int64_t ticks)
 {
-    return run_timers(&base_, ticks);
+    if (!collectBounded()) {
+        run_timers(&base_, ticks);
+        return dispatchExpired();
+    }
+    // walk ticks in small steps, so a long stall is sliced too
+    while (base_.timer_clk <= ticks && !collectStopped()) {
+        int64_t step = base_.timer_clk + BOUNDED_TICK_STEP - 1;
+        run_timers(&base_, step < ticks ? step : ticks);
+    }
+    return dispatchExpired();
 }
 
 TimeoutAction HHWheelTimer::findAndDelAction(int id)
@@ -90,11 +119,11 @@ void HHWheelTimer::handleTimerExpired(timer_list* timer)
 {
     assert(timer);
     auto wheel = reinterpret_cast<HHWheelTimer*>(timer->data);
-    TimeoutAction action = wheel->findAndDelAction(timer->id);
-    wheel->Cancel(timer->id);
-
-    if (action) {
-        action();
-    }
+    int id = timer->id;
+    int64_t expires = timer->expires;
+    uint64_t cookie = timer->cookie;
+    TimeoutAction action = wheel->findAndDelAction(id);
+    wheel->Cancel(id);
+    wheel->collectExpired(id, expires, cookie, std::move(action));
 }
 
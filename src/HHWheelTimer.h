@@ -29,12 +29,19 @@ public:
         return TimerSchedType::TIMER_HH_WHEEL;
     }
 
+    using TimerBase::Start;
+
     // start a timer after `duration` milliseconds
     int Start(uint32_t duration, TimeoutAction action) override;
 
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
     // cancel a timer
     bool Cancel(int timer_id) override;
 
+    using TimerBase::Update;
+
     // we assume 1 tick per ms
     int Update(int64_t ticks) override;
 
@@ -45,7 +52,11 @@ public:
 
     TimeoutAction findAndDelAction(int id);
 
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
 private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
     void clear();
     static void handleTimerExpired(timer_list*);
 
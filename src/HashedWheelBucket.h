@@ -44,6 +44,7 @@ public:
     int32_t remaining_rounds = 0;           // wheel round left
     int64_t deadline = 0;                   // expired time in ms
     int id = 0;                             // unique timer id
+    uint64_t cookie = 0;                    // user cookie of poll mode
     TimeoutAction action = nullptr;
 };
 
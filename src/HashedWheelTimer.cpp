@@ -5,6 +5,7 @@
 #include "HashedWheelBucket.h"
 #include <thread>
 #include <chrono>
+#include <algorithm>
 #include "Clock.h"
 #include "Logging.h"
 
@@ -45,11 +46,11 @@ void HashedWheelTimer::purge()
 }
 
 
-int HashedWheelTimer::Start(uint32_t duration, TimeoutAction action)
+int HashedWheelTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
 {
     int id = nextId();
-    int64_t deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
-    HashedWheelTimeout* timeout = allocTimeout(id, deadline, action);
+    HashedWheelTimeout* timeout = allocTimeout(id, deadline, std::move(action));
+    timeout->cookie = cookie;
     int calculated = (int)(timeout->deadline - started_at_) / TICK_DURATION;
     timeout->remaining_rounds = (calculated - ticks_) / WHEEL_SIZE;
     int ticks = calculated < ticks_ ? ticks_ : calculated;
@@ -59,11 +60,26 @@ int HashedWheelTimer::Start(uint32_t duration, TimeoutAction action)
     return id;
 }
 
+int HashedWheelTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int HashedWheelTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int HashedWheelTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
 bool HashedWheelTimer::Cancel(int timer_id)
 {
     auto iter = ref_.find(timer_id);
     if (iter == ref_.end()) {
-        return false;
+        return cancelExpired(timer_id);
     }
     HashedWheelTimeout* timeout = iter->second;
     if (timeout != nullptr) {
@@ -85,13 +101,17 @@ int HashedWheelTimer::Update(int64_t now)
     {
         return 0;
     }
+    int64_t last_time = last_time_;
     last_time_ = now;
-    int fired = 0;
     for (int64_t i = 0; i < ticks; i++)
     {
-        fired += tick();
+        if (collectStopped()) {
+            last_time_ = last_time + i * TIME_UNIT; // resume at this tick
+            break;
+        }
+        tick();
     }
-    return fired;
+    return dispatchExpired();
 }
 
 int HashedWheelTimer::tick()
@@ -102,9 +122,16 @@ int HashedWheelTimer::tick()
     std::vector<HashedWheelTimeout*> expired;
     bucket->ExpireTimeouts(deadline, expired);
     int count = (int)expired.size();
+    // a bucket spans a whole tick, keep deadline order
+    std::sort(expired.begin(), expired.end(), [](const HashedWheelTimeout* a, const HashedWheelTimeout* b) {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    });
     for (int i = 0; i < (int)expired.size(); i++) {
         HashedWheelTimeout* timeout = expired[i];
-        timeout->Expire();
+        collectExpired(timeout->id, timeout->deadline, timeout->cookie, std::move(timeout->action));
         delTimeout(timeout);
     }
     ticks_++;
@@ -29,12 +29,19 @@ public:
         return TimerSchedType::TIMER_HASHED_WHEEL;
     }
 
+    using TimerBase::Start;
+
     // start a timer after `duration` milliseconds
     int Start(uint32_t duration, TimeoutAction action) override;
 
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
     // cancel a timer
     bool Cancel(int timer_id) override;
 
+    using TimerBase::Update;
+
     int Update(int64_t now = 0) override;
 
     int Size() const override
@@ -42,10 +49,14 @@ public:
         return (int)ref_.size();
     }
 
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
 private:
     friend class HashedWheelTimeout;
     friend class HashedWheelBucket;
 
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
     int tick();
 
     void purge();
@@ -0,0 +1,160 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "HybridWheelTimer.h"
+#include "Clock.h"
+
+const int HYBRID_WHEEL_SIZE = 1 << 14;   // wheel horizon is about 16 seconds
+const int HYBRID_WHEEL_MASK = HYBRID_WHEEL_SIZE - 1;
+
+static inline HybridTimerNode* nodeOf(list_head* entry)
+{
+    return static_cast<HybridTimerNode*>(entry);
+}
+
+HybridWheelTimer::HybridWheelTimer()
+{
+    wheel_.resize(HYBRID_WHEEL_SIZE);
+    for (int i = 0; i < HYBRID_WHEEL_SIZE; i++) {
+        INIT_LIST_HEAD(&wheel_[i]);
+    }
+    heap_.reserve(64); // reserve a little space
+    cursor_ = Clock::CurrentTimeMillis();
+}
+
+HybridWheelTimer::~HybridWheelTimer()
+{
+    clear();
+}
+
+void HybridWheelTimer::clear()
+{
+    for (auto& kv : ref_) {
+        delete kv.second;
+    }
+    ref_.clear();
+    for (int i = 0; i < (int)wheel_.size(); i++) {
+        INIT_LIST_HEAD(&wheel_[i]);
+    }
+    heap_.clear();
+    wheel_count_ = 0;
+}
+
+void HybridWheelTimer::addToWheel(HybridTimerNode* node)
+{
+    // an overdue timer goes to next slot, behind timers of later deadline
+    int64_t expire = node->deadline;
+    if (expire < cursor_) {
+        expire = cursor_;
+        overdue_ = true;
+    }
+    list_add_tail(node, &wheel_[expire & HYBRID_WHEEL_MASK]);
+    wheel_count_++;
+}
+
+// move far timers into wheel once they are within horizon
+void HybridWheelTimer::migrate()
+{
+    while (!heap_.empty()) {
+        HybridTimerNode* node = heap_.top();
+        if (node->deadline >= cursor_ + HYBRID_WHEEL_SIZE) {
+            break;
+        }
+        heap_.pop();
+        addToWheel(node);
+    }
+}
+
+int HybridWheelTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+{
+    HybridTimerNode* node = new HybridTimerNode;
+    node->id = nextId();
+    node->deadline = deadline;
+    node->cookie = cookie;
+    node->action = std::move(action);
+    if (node->deadline < cursor_ + HYBRID_WHEEL_SIZE) {
+        addToWheel(node);
+    } else {
+        heap_.push(node);
+    }
+    ref_[node->id] = node;
+    return node->id;
+}
+
+int HybridWheelTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int HybridWheelTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int HybridWheelTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+bool HybridWheelTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    HybridTimerNode* node = iter->second;
+    ref_.erase(iter);
+    if (node->index >= 0) {
+        heap_.remove(node);
+    } else {
+        __list_del(node->prev, node->next);
+        wheel_count_--;
+    }
+    delete node;
+    return true;
+}
+
+void HybridWheelTimer::expireSlot(list_head* slot)
+{
+    while (!list_empty(slot)) {
+        HybridTimerNode* node = nodeOf(slot->next);
+        __list_del(node->prev, node->next);
+        wheel_count_--;
+        ref_.erase(node->id);
+        collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+        delete node;
+    }
+}
+
+int HybridWheelTimer::Update(int64_t now)
+{
+    int64_t start = cursor_;
+    while (cursor_ <= now) {
+        if (collectStopped()) {
+            break; // resume at this slot
+        }
+        if (wheel_count_ == 0) {
+            // skip empty slots
+            if (heap_.empty() || heap_.top()->deadline > now) {
+                cursor_ = now + 1;
+                migrate();
+                break;
+            }
+            if (cursor_ < heap_.top()->deadline) {
+                cursor_ = heap_.top()->deadline;
+            }
+            migrate();
+        }
+        list_head* slot = &wheel_[cursor_ & HYBRID_WHEEL_MASK];
+        cursor_++;
+        if (!list_empty(slot)) {
+            expireSlot(slot);
+        }
+        migrate();
+    }
+    if (overdue_ && cursor_ > start) {
+        sortExpired(); // overdue timers are collected in one slot with later ones
+        overdue_ = false;
+    }
+    return dispatchExpired();
+}
@@ -0,0 +1,106 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include "list_impl.h"
+#include <vector>
+#include <unordered_map>
+
+// the base list_head is the link in wheel slot
+struct HybridTimerNode : public list_head
+{
+    int index = -1;         // array index at heap, -1 if in wheel
+    int id = 0;             // unique timer id
+    int64_t deadline = 0;   // expired time in ms
+    uint64_t cookie = 0;    // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+struct HybridTimerNodeLess
+{
+    bool operator()(const HybridTimerNode* a, const HybridTimerNode* b) const
+    {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    }
+};
+
+// timer scheduler composed of a 1ms-resolution wheel for near timers and
+// a 4-ary heap for far timers.
+// a timer goes to wheel if its deadline is within the wheel horizon, so a slot
+// never holds more than one round, far timers migrate into wheel as the wheel turns.
+// timers of both parts share one id index, so `Cancel` doesn't care where a timer is.
+//
+// complexity:
+//             StartTimer    CancelTimer   PerTick
+//   near        O(1)           O(1)         O(1)
+//   far       O(log N)       O(log N)       O(1)
+//
+class HybridWheelTimer : public TimerBase
+{
+public:
+    HybridWheelTimer();
+    ~HybridWheelTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_HYBRID_WHEEL;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return (int)ref_.size();
+    }
+
+    // count of timers in wheel
+    int WheelSize() const
+    {
+        return wheel_count_;
+    }
+
+    // count of timers in heap
+    int HeapSize() const
+    {
+        return heap_.size();
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
+    void clear();
+
+    void addToWheel(HybridTimerNode* node);
+    void migrate();
+    void expireSlot(list_head* slot);
+
+private:
+    std::vector<list_head> wheel_;
+    DAryHeap<4, HybridTimerNode, HybridTimerNodeLess> heap_;
+    std::unordered_map<int, HybridTimerNode*> ref_; // to make O(1) lookup
+
+    int wheel_count_ = 0;
+    int64_t cursor_ = 0;    // time of next slot to expire
+    bool overdue_ = false;  // an overdue timer was put into cursor slot
+};
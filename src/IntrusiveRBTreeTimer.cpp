@@ -0,0 +1,174 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "IntrusiveRBTreeTimer.h"
+#include "Clock.h"
+#include "Logging.h"
+
+const int ENTRY_BLOCK_SIZE = 64;    // entries per allocation
+
+static inline RBTimerEntry* entryOf(rb_node* node)
+{
+    return static_cast<RBTimerEntry*>(node);
+}
+
+// same ordering as RBTreeTimer::NodeKey
+static inline bool entryLess(const RBTimerEntry* a, const RBTimerEntry* b)
+{
+    if (a->deadline == b->deadline) {
+        return a->id > b->id;
+    }
+    return a->deadline < b->deadline;
+}
+
+IntrusiveRBTreeTimer::IntrusiveRBTreeTimer()
+{
+}
+
+IntrusiveRBTreeTimer::~IntrusiveRBTreeTimer()
+{
+    clear();
+}
+
+void IntrusiveRBTreeTimer::clear()
+{
+    // caller-owned entries are unlinked only
+    while (leftmost_ != nullptr) {
+        unlink(entryOf(leftmost_));
+    }
+    for (auto block : blocks_) {
+        delete[] block;
+    }
+    blocks_.clear();
+    free_list_.clear();
+    ref_.clear();
+}
+
+RBTimerEntry* IntrusiveRBTreeTimer::allocEntry()
+{
+    if (free_list_.empty()) {
+        RBTimerEntry* block = new RBTimerEntry[ENTRY_BLOCK_SIZE];
+        blocks_.push_back(block);
+        for (int i = ENTRY_BLOCK_SIZE - 1; i >= 0; i--) {
+            block[i].pooled = true;
+            free_list_.push_back(&block[i]);
+        }
+    }
+    RBTimerEntry* entry = free_list_.back();
+    free_list_.pop_back();
+    return entry;
+}
+
+void IntrusiveRBTreeTimer::freeEntry(RBTimerEntry* entry)
+{
+    entry->action = nullptr;
+    free_list_.push_back(entry);
+}
+
+void IntrusiveRBTreeTimer::link(RBTimerEntry* entry)
+{
+    rb_node** link = &root_.node;
+    rb_node* parent = nullptr;
+    bool leftmost = true;
+    while (*link != nullptr) {
+        parent = *link;
+        if (entryLess(entry, entryOf(parent))) {
+            link = &parent->rb_left;
+        } else {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+    rb_link_node(entry, parent, link);
+    rb_insert_color(entry, &root_);
+    if (leftmost) {
+        leftmost_ = entry;
+    }
+    size_++;
+}
+
+void IntrusiveRBTreeTimer::unlink(RBTimerEntry* entry)
+{
+    if (leftmost_ == entry) {
+        leftmost_ = rb_next(leftmost_);
+    }
+    rb_erase(entry, &root_);
+    size_--;
+}
+
+int IntrusiveRBTreeTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
+{
+    RBTimerEntry* entry = allocEntry();
+    entry->id = nextId();
+    entry->deadline = deadline;
+    entry->cookie = cookie;
+    entry->action = std::move(action);
+    link(entry);
+    ref_[entry->id] = entry;
+    return entry->id;
+}
+
+int IntrusiveRBTreeTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int IntrusiveRBTreeTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int IntrusiveRBTreeTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+bool IntrusiveRBTreeTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return cancelExpired(timer_id);
+    }
+    RBTimerEntry* entry = iter->second;
+    ref_.erase(iter);
+    unlink(entry);
+    freeEntry(entry);
+    return true;
+}
+
+int IntrusiveRBTreeTimer::Schedule(RBTimerEntry* entry, uint32_t duration)
+{
+    CHECK(!entry->pooled);
+    CHECK(!rb_linked(entry));
+    entry->id = nextId();
+    entry->deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
+    link(entry);
+    return entry->id;
+}
+
+bool IntrusiveRBTreeTimer::Unschedule(RBTimerEntry* entry)
+{
+    CHECK(!entry->pooled);
+    if (!rb_linked(entry)) {
+        return cancelExpired(entry->id);
+    }
+    unlink(entry);
+    return true;
+}
+
+int IntrusiveRBTreeTimer::Update(int64_t now)
+{
+    while (leftmost_ != nullptr) {
+        RBTimerEntry* entry = entryOf(leftmost_);
+        if (now < entry->deadline || collectStopped()) {
+            break; // no more due timer to trigger
+        }
+        unlink(entry);
+        collectExpired(entry->id, entry->deadline, entry->cookie, std::move(entry->action));
+        if (entry->pooled) {
+            ref_.erase(entry->id);
+            freeEntry(entry);
+        }
+    }
+    return dispatchExpired();
+}
@@ -0,0 +1,93 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "rbtree.h"
+#include <vector>
+#include <unordered_map>
+
+// timer record with an embedded red-black tree hook(the base rb_node).
+// users may embed it in their own structures and schedule it by
+// `IntrusiveRBTreeTimer::Schedule()`, so no allocation or lookup is needed.
+struct RBTimerEntry : public rb_node
+{
+    int id = 0;                         // unique timer id
+    bool pooled = false;                // owned by the timer pool
+    int64_t deadline = 0;               // expired time in ms
+    uint64_t cookie = 0;                // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+// timer scheduler implemented by intrusive red-black tree.
+// same ordering as RBTreeTimer, but the tree node is the timer record itself,
+// the leftmost node is cached and records are recycled by a free list.
+//
+// complexity:
+//      StartTimer  CancelTimer   PerTick
+//       O(logN)     O(logN)       O(1)
+//
+class IntrusiveRBTreeTimer : public TimerBase
+{
+public:
+    IntrusiveRBTreeTimer();
+    ~IntrusiveRBTreeTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_INTRUSIVE_RBTREE;
+    }
+
+    using TimerBase::Start;
+
+    // start a timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return size_;
+    }
+
+    // schedule a caller-owned entry with `entry->action` after `duration` milliseconds.
+    // the entry must stay alive until it is fired or unscheduled,
+    // fired entries are unlinked and can be scheduled again, the action is moved out
+    // when fired, so set `entry->action` again before rescheduling.
+    // a scheduled entry is not in the id lookup, `Cancel(id)` returns false while it is
+    // pending, cancel it by `Unschedule(entry)` only.
+    int Schedule(RBTimerEntry* entry, uint32_t duration);
+
+    // unlink a caller-owned entry, no search is needed
+    bool Unschedule(RBTimerEntry* entry);
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
+    void clear();
+    void link(RBTimerEntry* entry);
+    void unlink(RBTimerEntry* entry);
+
+    RBTimerEntry* allocEntry();
+    void freeEntry(RBTimerEntry* entry);
+
+private:
+    rb_root root_;
+    rb_node* leftmost_ = nullptr;   // cached minimum node
+    int size_ = 0;
+
+    std::vector<RBTimerEntry*> free_list_;  // recycled entries
+    std::vector<RBTimerEntry*> blocks_;     // allocated entry blocks
+    std::unordered_map<int, RBTimerEntry*> ref_;  // id lookup of pooled entries
+};
@@ -0,0 +1,96 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// bounded lock-free queue of many producers and a single consumer.
+//
+// each cell carries a sequence number as in Dmitry Vyukov's bounded MPMC queue,
+// producers claim a cell by CAS on tail, the consumer owns head exclusively.
+// see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename T>
+class MPSCQueue
+{
+public:
+    // `capacity` is rounded up to power of 2
+    explicit MPSCQueue(int capacity)
+    {
+        size_t size = 2;
+        while (size < (size_t)capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // push from any thread, return false if queue is full
+    bool TryPush(T&& value)
+    {
+        Cell* cell = nullptr;
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pop by the consumer thread only, return false if queue is empty
+    bool TryPop(T& value)
+    {
+        Cell* cell = &cells_[head_ & mask_];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(head_ + 1) < 0) {
+            return false; // empty or being written
+        }
+        value = std::move(cell->value);
+        cell->seq.store(head_ + mask_ + 1, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+    size_t Capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    // padded instead of `alignas(64)`, which plain `new` of C++11 does not honor
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    char pad0_[64 - sizeof(size_t)];
+    std::atomic<size_t> tail_{0};               // written by producers
+    char pad1_[64 - sizeof(std::atomic<size_t>)];
+    size_t head_ = 0;                           // owned by consumer
+    char pad2_[64 - sizeof(size_t)];
+};
@@ -0,0 +1,144 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "PrecisionTimer.h"
+#include "Clock.h"
+
+const int COARSE_WHEEL_SIZE = 1024;     // horizon is 102s and 17min
+const int COARSE_WHEEL_MASK = COARSE_WHEEL_SIZE - 1;
+
+static const int64_t Granularities[] = {100, 1000};
+
+PrecisionTimer::PrecisionTimer(TimerSchedType exact)
+{
+    exact_ = CreateTimer(exact);
+    int64_t now = Clock::CurrentTimeMillis();
+    for (int i = 0; i < 2; i++) {
+        CoarseWheel& wheel = wheels_[i];
+        wheel.granularity = Granularities[i];
+        wheel.cursor = now / wheel.granularity;
+        wheel.slots.resize(COARSE_WHEEL_SIZE);
+        for (int j = 0; j < COARSE_WHEEL_SIZE; j++) {
+            INIT_LIST_HEAD(&wheel.slots[j]);
+        }
+    }
+}
+
+PrecisionTimer::~PrecisionTimer()
+{
+    clear();
+}
+
+void PrecisionTimer::clear()
+{
+    for (auto& kv : ref_) {
+        delete kv.second;
+    }
+    ref_.clear();
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < COARSE_WHEEL_SIZE; j++) {
+            INIT_LIST_HEAD(&wheels_[i].slots[j]);
+        }
+        wheels_[i].count = 0;
+    }
+}
+
+// deadline is rounded up to next tick, so it never fires early
+void PrecisionTimer::addToWheel(CoarseTimerNode* node)
+{
+    CoarseWheel& wheel = wheels_[node->wheel];
+    int64_t tick = (node->deadline + wheel.granularity - 1) / wheel.granularity;
+    if (tick < wheel.cursor) {
+        tick = wheel.cursor;
+    }
+    node->rounds = (int)((tick - wheel.cursor) / COARSE_WHEEL_SIZE);
+    list_add_tail(node, &wheel.slots[tick & COARSE_WHEEL_MASK]);
+    wheel.count++;
+}
+
+int PrecisionTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return exact_->Start(duration, std::move(action));
+}
+
+int PrecisionTimer::Start(uint32_t duration, TimeoutAction action, Precision precision)
+{
+    if (precision == Precision::Exact) {
+        return exact_->Start(duration, std::move(action));
+    }
+    CoarseTimerNode* node = new CoarseTimerNode;
+    node->id = nextIdOf(exact_.get());
+    node->wheel = precision == Precision::Coarse100ms ? 0 : 1;
+    node->deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
+    node->action = std::move(action);
+    addToWheel(node);
+    ref_[node->id] = node;
+    return node->id;
+}
+
+int PrecisionTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return exact_->StartPoll(duration, cookie);
+}
+
+int PrecisionTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return startAtOf(exact_.get(), deadline, std::move(action));
+}
+
+bool PrecisionTimer::Cancel(int timer_id)
+{
+    auto iter = ref_.find(timer_id);
+    if (iter == ref_.end()) {
+        return exact_->Cancel(timer_id) || cancelExpired(timer_id);
+    }
+    CoarseTimerNode* node = iter->second;
+    ref_.erase(iter);
+    __list_del(node->prev, node->next);
+    wheels_[node->wheel].count--;
+    delete node;
+    return true;
+}
+
+void PrecisionTimer::expireWheel(CoarseWheel& wheel, int64_t now)
+{
+    int64_t last = now / wheel.granularity; // last tick due
+    while (wheel.cursor <= last) {
+        if (collectStopped()) {
+            break; // resume at this tick
+        }
+        if (wheel.count == 0) {
+            wheel.cursor = last + 1;
+            break;
+        }
+        list_head* slot = &wheel.slots[wheel.cursor & COARSE_WHEEL_MASK];
+        wheel.cursor++;
+        list_head* pos = slot->next;
+        while (pos != slot) {
+            CoarseTimerNode* node = static_cast<CoarseTimerNode*>(pos);
+            pos = pos->next;
+            if (node->rounds > 0) {
+                node->rounds--;
+                continue;
+            }
+            __list_del(node->prev, node->next);
+            wheel.count--;
+            ref_.erase(node->id);
+            collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+            delete node;
+        }
+    }
+}
+
+int PrecisionTimer::Update(int64_t now)
+{
+    collectInner(exact_.get(), now);
+    int exact = ExpiredBacklog();
+    for (int i = 0; i < 2; i++) {
+        expireWheel(wheels_[i], now);
+    }
+    if (ExpiredBacklog() > exact) {
+        sortExpired(); // wheels are collected one after another, and a slot in start order
+    }
+    return dispatchExpired();
+}
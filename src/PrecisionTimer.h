@@ -0,0 +1,102 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "list_impl.h"
+#include <vector>
+#include <unordered_map>
+
+// how late a timer may fire
+enum class Precision
+{
+    Exact = 0,          // by the exact scheduler
+    Coarse100ms = 1,    // at most 100ms late
+    Coarse1s = 2,       // at most 1s late
+};
+
+// the base list_head is the link in coarse wheel slot
+struct CoarseTimerNode : public list_head
+{
+    int id = 0;             // unique timer id
+    int rounds = 0;         // wheel turns left before expired
+    int wheel = 0;          // index of owner wheel
+    int64_t deadline = 0;   // expired time in ms
+    uint64_t cookie = 0;    // user cookie of poll mode
+    TimeoutAction action = nullptr;
+};
+
+// a hashed wheel ticked once per `granularity` milliseconds
+struct CoarseWheel
+{
+    int64_t granularity = 0;
+    int64_t cursor = 0;             // next tick to expire, in granularity
+    int count = 0;                  // count of timers in wheel
+    std::vector<list_head> slots;
+};
+
+// timer scheduler which routes timers by precision.
+//
+// exact timers go to the configured scheduler, coarse timers go to a small wheel
+// of 100ms or 1s granularity, the coarse wheel is ticked only when its granularity
+// elapses, so most `Update()` calls cost no more than the exact scheduler.
+// a coarse timer never fires early, its deadline is rounded up to next tick.
+//
+// complexity of coarse timers:
+//     StartTimer    CancelTimer   PerTick
+//       O(1)           O(1)         O(1)
+//
+class PrecisionTimer : public TimerBase
+{
+public:
+    explicit PrecisionTimer(TimerSchedType exact = TimerSchedType::TIMER_DARY_HEAP);
+    ~PrecisionTimer();
+
+    TimerSchedType Type() const override
+    {
+        return TimerSchedType::TIMER_PRECISION;
+    }
+
+    using TimerBase::Start;
+
+    // start an exact timer after `duration` milliseconds
+    int Start(uint32_t duration, TimeoutAction action) override;
+
+    // start a timer after `duration` milliseconds with given precision
+    int Start(uint32_t duration, TimeoutAction action, Precision precision);
+
+    // start an exact timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
+    // cancel a timer
+    bool Cancel(int timer_id) override;
+
+    using TimerBase::Update;
+
+    int Update(int64_t now = 0) override;
+
+    int Size() const override
+    {
+        return exact_->Size() + (int)ref_.size();
+    }
+
+    // count of timers in coarse wheels
+    int CoarseSize() const
+    {
+        return (int)ref_.size();
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
+private:
+    void clear();
+    void addToWheel(CoarseTimerNode* node);
+    void expireWheel(CoarseWheel& wheel, int64_t now);
+
+private:
+    std::shared_ptr<TimerBase> exact_;
+    CoarseWheel wheels_[2];                             // 100ms and 1s
+    std::unordered_map<int, CoarseTimerNode*> ref_;     // to make O(1) lookup
+};
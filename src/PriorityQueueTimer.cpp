@@ -3,14 +3,19 @@
 
 #include "PriorityQueueTimer.h"
 #include "Clock.h"
+#include <algorithm>
+#include <functional>
 
 using namespace std;
 
+const int EXPIRING = -1;    // popped from heap
+
 struct TimerNode
 {
-    int index = -1;  // array index at heap
+    int index = -1;  // array index at heap, or EXPIRING out of heap
     int id = 0;      // unique timer id
     int64_t deadline = 0;   // expired time in ms
+    uint64_t cookie = 0;    // user cookie of poll mode
     TimeoutAction action = nullptr;
 
     bool lessThan(const TimerNode* b) const
@@ -23,7 +28,11 @@ struct TimerNode
 };
 
 
-PriorityQueueTimer::PriorityQueueTimer()
+// don't bother to compact a small heap
+const int MIN_COMPACT_DEAD = 64;
+
+PriorityQueueTimer::PriorityQueueTimer(bool lazy_cancel)
+    : lazy_cancel_(lazy_cancel)
 {
     timers_.reserve(64); // reserve a little space
 }
@@ -36,12 +45,14 @@ PriorityQueueTimer::~PriorityQueueTimer()
 
 void PriorityQueueTimer::clear()
 {
-    for (auto& kv : ref_)
+    // stale nodes are not in `ref_`
+    for (auto node : timers_)
     {
-        delete(kv.second);
+        delete(node);
     }
     ref_.clear();
     timers_.clear();
+    dead_ = 0;
 }
 
 // Heap maintenance algorithms.
@@ -59,7 +70,7 @@ static bool siftdownTimer(vector<TimerNode*>& timers, int x, int n)
         }
         int j = j1; // left child
         int j2 = j1 + 1;
-        if (j2 < n && !(timers[j1] < timers[j2])) {
+        if (j2 < n && !timers[j1]->lessThan(timers[j2])) {
             j = j2; // = 2*i + 2right child
         }
         if (!(timers[j]->lessThan(timers[i]))) {
@@ -77,7 +88,7 @@ static void siftupTimer(vector<TimerNode*>& timers, int j)
 {
     for (;;) {
         int i = (j - 1) / 2; // parent node
-        if (i == j || !(timers[j] < timers[i])) {
+        if (i == j || !timers[j]->lessThan(timers[i])) {
             break;
         }
         std::swap(timers[i], timers[j]);
@@ -102,17 +113,17 @@ static void removeTimer(vector<TimerNode*>& timers, int i) {
     timers.pop_back();
 }
 
-int PriorityQueueTimer::Start(uint32_t duration, TimeoutAction action)
+int PriorityQueueTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
 {
     int id = nextId();
-    int64_t expire = Clock::CurrentTimeMillis() + (int64_t)duration;
     int i = (int)timers_.size();
 
     TimerNode* node = new TimerNode;
     node->id = id;
     node->index = i;
-    node->deadline = expire;
-    node->action = action;
+    node->deadline = deadline;
+    node->cookie = cookie;
+    node->action = std::move(action);
 
     ref_[id] = node;
     timers_.push_back(node);
@@ -121,46 +132,168 @@ int PriorityQueueTimer::Start(uint32_t duration, TimeoutAction action)
     return id;
 }
 
+int PriorityQueueTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int PriorityQueueTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int PriorityQueueTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
 bool PriorityQueueTimer::Cancel(int timer_id)
 {
     auto iter = ref_.find(timer_id);
     if (iter != ref_.end()) {
         TimerNode* node = iter->second;
-        removeTimer(timers_, node->index);
         ref_.erase(iter);
+        if (lazy_cancel_) {
+            // leave node in heap, it is stale without id, release captures of callback now
+            node->action = nullptr;
+            dead_++;
+            if (ref_.empty() || (dead_ >= MIN_COMPACT_DEAD && dead_ > (int)ref_.size())) {
+                compact();
+            }
+            return true;
+        }
+        removeTimer(timers_, node->index);
         delete node;
         return true;
     }
-    return false;
+    return cancelExpired(timer_id);
 }
 
-int PriorityQueueTimer::Update(int64_t now)
+// drop all stale nodes and rebuild heap in O(N)
+void PriorityQueueTimer::compact()
 {
-    if (timers_.empty()) {
-        return 0;
-    }
-    int fired = 0;
-    int max_id = next_id_;
-    while (!timers_.empty()) {
-        TimerNode* node = timers_[0];
-        if (now < node->deadline) {
-            break; // no timer expired
+    int n = 0;
+    for (int i = 0; i < (int)timers_.size(); i++) {
+        TimerNode* node = timers_[i];
+        if (ref_.count(node->id) == 0) {
+            delete node;
+        } else {
+            timers_[n] = node;
+            node->index = n++;
         }
-        if (node->id > max_id) {
-            break; // process newly added timer at next tick
+    }
+    timers_.resize(n);
+    dead_ = 0;
+    for (int i = (n - 2) / 2; n > 1 && i >= 0; i--) {
+        siftdownTimer(timers_, i, n);
+    }
+}
+
+// pop all timers due at `now` in one pass.
+// due timers form a subtree at heap top, collect it by traversal,
+// then remove them one by one or rebuild the heap, whichever is cheaper.
+void PriorityQueueTimer::popExpired(int64_t now)
+{
+    due_.clear();
+    if (timers_.empty() || now < timers_[0]->deadline) {
+        return;
+    }
+    int n = (int)timers_.size();
+    stack_.clear();
+    stack_.push_back(0);
+    while (!stack_.empty()) {
+        int i = stack_.back();
+        stack_.pop_back();
+        due_.push_back(i);
+        for (int c = 2 * i + 1; c <= 2 * i + 2 && c < n; c++) {
+            if (timers_[c]->deadline <= now) {
+                stack_.push_back(c);
+            }
         }
-        auto action = std::move(node->action);
+    }
 
-        removeTimer(timers_, 0);
-        ref_.erase(node->id);
-        delete node;
+    int k = (int)due_.size();
+    int levels = 1;
+    for (int m = n; m > 1; m >>= 1) {
+        levels++;
+    }
+    expired_.clear();
+    if (k * levels > n) {
+        for (int i : due_) {
+            timers_[i]->index = EXPIRING;
+        }
+        int j = 0;
+        for (int i = 0; i < n; i++) {
+            TimerNode* node = timers_[i];
+            if (node->index == EXPIRING) {
+                expired_.push_back(node);
+            } else {
+                timers_[j] = node;
+                node->index = j++;
+            }
+        }
+        timers_.resize(j);
+        for (int i = (j - 2) / 2; j > 1 && i >= 0; i--) {
+            siftdownTimer(timers_, i, j);
+        }
+    } else {
+        // remove from bottom up, so the moved last node is never a due one
+        std::sort(due_.begin(), due_.end(), std::greater<int>());
+        for (int i : due_) {
+            TimerNode* node = timers_[i];
+            removeTimer(timers_, i);
+            node->index = EXPIRING;
+            expired_.push_back(node);
+        }
+    }
+    if (dead_ > 0) {
+        // drop nodes canceled lazily
+        int j = 0;
+        for (TimerNode* node : expired_) {
+            if (ref_.count(node->id) == 0) {
+                dead_--;
+                delete node;
+            } else {
+                expired_[j++] = node;
+            }
+        }
+        expired_.resize(j);
+    }
+    std::sort(expired_.begin(), expired_.end(), [](const TimerNode* a, const TimerNode* b) {
+        return a->lessThan(b);
+    });
+}
 
-        fired++;
+int64_t PriorityQueueTimer::NextDeadline() const
+{
+    if (ref_.empty()) {
+        return -1;
+    }
+    return timers_[0]->deadline;
+}
 
-        if (action) {
-            action();
+int PriorityQueueTimer::Update(int64_t now)
+{
+    if (collectBounded()) {
+        // pop one by one, so collecting stops within budget
+        while (!timers_.empty() && timers_[0]->deadline <= now && !collectStopped()) {
+            TimerNode* node = timers_[0];
+            removeTimer(timers_, 0);
+            if (ref_.erase(node->id) > 0) {
+                collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+            } else {
+                dead_--; // canceled lazily
+            }
+            delete node;
         }
+        return dispatchExpired();
     }
-    return fired;
+    popExpired(now);
+    for (TimerNode* node : expired_) {
+        ref_.erase(node->id);
+        collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+        delete node;
+    }
+    expired_.clear();
+    return dispatchExpired();
 }
-
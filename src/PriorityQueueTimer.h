@@ -10,6 +10,12 @@
 
 // timer scheduler implemented by priority queue(min-heap)
 //
+// all timers due in one `Update()` are popped in one pass, then dispatched.
+//
+// with `lazy_cancel`, Cancel only drops the id from index and leaves the node in heap,
+// stale nodes are discarded when they surface, and the heap is compacted
+// once stale nodes outnumber pending ones or none is pending.
+//
 // complexity:
 //     StartTimer  CancelTimer   PerTick
 //      O(log N)    O(log N)       O(1)
@@ -20,10 +26,7 @@ struct TimerNode;
 class PriorityQueueTimer : public TimerBase
 {
 public:
-
-
-public:
-    PriorityQueueTimer();
+    explicit PriorityQueueTimer(bool lazy_cancel = false);
     ~PriorityQueueTimer();
 
     TimerSchedType Type() const override
@@ -31,23 +34,50 @@ public:
         return TimerSchedType::TIMER_PRIORITY_QUEUE;
     }
 
+    using TimerBase::Start;
+
     // start a timer after `duration` milliseconds
     int Start(uint32_t duration, TimeoutAction action) override;
 
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
     // cancel a timer
     bool Cancel(int timer_id) override;
 
+    using TimerBase::Update;
+
     int Update(int64_t now = 0) override;
 
     int Size() const override 
     {
-        return (int)timers_.size();
+        return (int)ref_.size();
+    }
+
+    // deadline of heap top, a canceled timer may be on top with lazy cancel
+    int64_t NextDeadline() const override;
+
+    // count of canceled timers still in heap, lazy cancel only
+    int DeadCount() const
+    {
+        return dead_;
     }
 
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
 private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
     void clear();
+    void compact();
+    void popExpired(int64_t now);
 
 private:
     std::vector<TimerNode*>  timers_; // binary timer heap
     std::unordered_map<int, TimerNode*> ref_; // to make O(1) lookup
+    std::vector<TimerNode*>  expired_; // scratch of popped timers
+    std::vector<int> due_;             // scratch of due heap indices
+    std::vector<int> stack_;           // scratch of heap traversal
+    bool lazy_cancel_ = false;
+    int dead_ = 0;                     // count of stale nodes in heap
 };
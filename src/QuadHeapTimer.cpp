@@ -5,18 +5,32 @@
 #include "QuadHeapTimer.h"
 #include "Clock.h"
 #include "Logging.h"
+#include <algorithm>
+#include <functional>
 
 using namespace std;
 
+// state of a timer node
+enum
+{
+    NODE_PENDING = 0,
+    NODE_DELETED = 1,   // canceled, a tombstone in heap
+};
+
 struct TimerNode
 {
     int id = 0;       // unique timer id
     int deleted = 0;  // lazy deletion
     int64_t deadline = 0;
+    uint64_t cookie = 0;  // user cookie of poll mode
     TimeoutAction action = nullptr;
 };
 
-QuadHeapTimer::QuadHeapTimer()
+// don't bother to compact a small heap
+const int MIN_COMPACT_DEAD = 64;
+
+QuadHeapTimer::QuadHeapTimer(double compact_ratio)
+    : compact_ratio_(compact_ratio)
 {
     timers_.reserve(64); // reserve a little space
 }
@@ -29,12 +43,14 @@ QuadHeapTimer::~QuadHeapTimer()
 
 void QuadHeapTimer::clear()
 {
-    for (auto& kv : ref_)
+    // tombstones are not in `ref_`
+    for (auto node : timers_)
     {
-        delete kv.second;
+        delete node;
     }
     ref_.clear();
     timers_.clear();
+    dead_ = 0;
 }
 
 // Heap maintenance algorithms.
@@ -109,8 +125,8 @@ static void siftdownTimer(vector<TimerNode*>& timers, int i)
 // returns the smallest changed index in `timers`
 int deltimer(vector<TimerNode*>& timers, int i) {
     int last = int(timers.size()) - 1;
-    if (last > 0) {
-        timers[0] = timers[last];
+    if (i != last) {
+        timers[i] = timers[last];
     }
     timers[last] = nullptr;
     timers.pop_back();
@@ -137,16 +153,16 @@ void deltimer0(vector<TimerNode*>& timers) {
     }
 }
 
-int QuadHeapTimer::Start(uint32_t duration, TimeoutAction action)
+int QuadHeapTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
 {
     int id = nextId();
-    int64_t expire = Clock::CurrentTimeMillis() + (int64_t)duration;
     int i = (int)timers_.size();
 
     TimerNode* node = new TimerNode();
     node->id = id;
-    node->deadline = expire;
-    node->action = action;
+    node->deadline = deadline;
+    node->cookie = cookie;
+    node->action = std::move(action);
 
     ref_[id] = node;
     timers_.push_back(node);
@@ -155,52 +171,158 @@ int QuadHeapTimer::Start(uint32_t duration, TimeoutAction action)
     return id;
 }
 
+int QuadHeapTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int QuadHeapTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int QuadHeapTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
+// drop all tombstones and rebuild heap in O(N)
+void QuadHeapTimer::compact()
+{
+    int n = 0;
+    for (int i = 0; i < (int)timers_.size(); i++) {
+        TimerNode* node = timers_[i];
+        if (node->deleted == NODE_DELETED) {
+            delete node;
+        } else {
+            timers_[n++] = node;
+        }
+    }
+    timers_.resize(n);
+    dead_ = 0;
+    for (int i = (n - 2) / 4; n > 1 && i >= 0; i--) {
+        siftdownTimer(timers_, i);
+    }
+}
+
 bool QuadHeapTimer::Cancel(int timer_id)
 {
     auto iter = ref_.find(timer_id);
     if (iter != ref_.end()) {
-        iter->second->deleted = 1;
+        TimerNode* node = iter->second;
+        node->action = nullptr;
         ref_.erase(iter);
+        node->deleted = NODE_DELETED;
+        dead_++;
+        if (dead_ >= MIN_COMPACT_DEAD && dead_ > compact_ratio_ * timers_.size()) {
+            compact();
+        }
         return true;
     }
-    return false;
+    return cancelExpired(timer_id);
 }
 
-int QuadHeapTimer::Update(int64_t now)
+// pop all timers due at `now` in one pass.
+// due timers form a subtree at heap top, collect it by traversal,
+// then remove them one by one or rebuild the heap, whichever is cheaper.
+void QuadHeapTimer::popExpired(int64_t now)
 {
-    if (timers_.empty()) {
-        return 0;
+    due_.clear();
+    if (timers_.empty() || now < timers_[0]->deadline) {
+        return;
     }
-    int fired = 0;
-    int max_id = next_id_;
-    while (!timers_.empty()) {
-        TimerNode* node = timers_[0];
-        if (now < node->deadline) {
-            break; // no timer expired
+    int n = (int)timers_.size();
+    stack_.clear();
+    stack_.push_back(0);
+    while (!stack_.empty()) {
+        int i = stack_.back();
+        stack_.pop_back();
+        due_.push_back(i);
+        for (int c = 4 * i + 1; c <= 4 * i + 4 && c < n; c++) {
+            if (timers_[c]->deadline <= now) {
+                stack_.push_back(c);
+            }
         }
-        if (node->id > max_id) {
-            break; // process newly added timer at next tick
+    }
+
+    int k = (int)due_.size();
+    int levels = 1;
+    for (int m = n; m > 1; m >>= 2) {
+        levels++;
+    }
+    expired_.clear();
+    if (k * levels > n) {
+        for (int i : due_) {
+            expired_.push_back(timers_[i]);
+            timers_[i] = nullptr;
         }
-        if (node->deleted) {
-            deltimer0(timers_);
-            ref_.erase(node->id);
+        timers_.erase(std::remove(timers_.begin(), timers_.end(), nullptr), timers_.end());
+        int m = (int)timers_.size();
+        for (int i = (m - 2) / 4; m > 1 && i >= 0; i--) {
+            siftdownTimer(timers_, i);
+        }
+    } else {
+        // remove from bottom up, so the moved last node is never a due one
+        std::sort(due_.begin(), due_.end(), std::greater<int>());
+        for (int i : due_) {
+            expired_.push_back(timers_[i]);
+            deltimer(timers_, i);
+        }
+    }
+    int j = 0;
+    for (TimerNode* node : expired_) {
+        if (node->deleted == NODE_DELETED) {
+            dead_--;
             delete node;
-            continue;
+        } else {
+            expired_[j++] = node;
+        }
+    }
+    expired_.resize(j);
+    std::sort(expired_.begin(), expired_.end(), [](const TimerNode* a, const TimerNode* b) {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
         }
+        return a->deadline < b->deadline;
+    });
+}
 
-        auto action = std::move(node->action);
+int64_t QuadHeapTimer::NextDeadline() const
+{
+    if (ref_.empty()) {
+        return -1;
+    }
+    return timers_[0]->deadline;
+}
 
-        deltimer0(timers_);
+int QuadHeapTimer::Update(int64_t now)
+{
+    if (collectBounded()) {
+        // pop one by one, so collecting stops within budget,
+        // but never in the middle of a same deadline run, heap order has no tie-break
+        int64_t last = INT64_MIN;
+        while (!timers_.empty() && timers_[0]->deadline <= now &&
+            (timers_[0]->deadline == last || !collectStopped())) {
+            TimerNode* node = timers_[0];
+            last = node->deadline;
+            deltimer0(timers_);
+            if (node->deleted == NODE_DELETED) {
+                dead_--; // tombstone
+            } else {
+                ref_.erase(node->id);
+                collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
+            }
+            delete node;
+        }
+        sortExpired();
+        return dispatchExpired();
+    }
+    popExpired(now);
+    for (TimerNode* node : expired_) {
         ref_.erase(node->id);
+        collectExpired(node->id, node->deadline, node->cookie, std::move(node->action));
         delete node;
-
-        fired++;
-
-        if (action) {
-            action();
-        }
     }
-    return fired;
+    expired_.clear();
+    return dispatchExpired();
 }
-
-
@@ -12,6 +12,10 @@
 // 
 // timer scheduler implemented by quaternary-ary heap
 //
+// canceled timers are marked deleted and stay in heap(tombstones),
+// the heap is rebuilt in O(N) once the dead fraction exceeds `compact_ratio`.
+// all timers due in one `Update()` are popped in one pass, then dispatched.
+//
 // complexity:
 //     StartTimer    CancelTimer   PerTick
 //      O(logN)      O(logN)          O(1)
@@ -21,7 +25,7 @@ struct TimerNode;
 
 class QuadHeapTimer : public TimerBase
 {public:
-    QuadHeapTimer();
+    explicit QuadHeapTimer(double compact_ratio = 0.5);
     ~QuadHeapTimer();
 
     TimerSchedType Type() const override
@@ -29,23 +33,61 @@ class QuadHeapTimer : public TimerBase
         return TimerSchedType::TIMER_QUAD_HEAP;
     }
 
+    using TimerBase::Start;
+
     // start a timer after `duration` milliseconds
     int Start(uint32_t duration, TimeoutAction action) override;
 
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
     // cancel a timer
     bool Cancel(int timer_id) override;
 
+    using TimerBase::Update;
+
     int Update(int64_t now = 0) override;
 
     int Size() const override 
     {
-        return (int)timers_.size();
+        return (int)ref_.size();
     }    
 
+    // deadline of heap top, a canceled timer may be on top
+    int64_t NextDeadline() const override;
+
+    // count of pending timers in heap
+    int LiveCount() const
+    {
+        return (int)timers_.size() - dead_;
+    }
+
+    // count of canceled timers still in heap
+    int DeadCount() const
+    {
+        return dead_;
+    }
+
+    // rebuild heap once DeadCount() > ratio * heap size, ratio >= 1 disables it
+    void SetCompactRatio(double ratio)
+    {
+        compact_ratio_ = ratio;
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
 private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
     void clear();
-    int delTimer(TimerNode& node);
+    void compact();
+    void popExpired(int64_t now);
 
     std::vector<TimerNode*>  timers_; // 4-ary heap
     std::unordered_map<int, TimerNode*> ref_; // O(1) search
+    std::vector<TimerNode*>  expired_; // scratch of popped timers
+    std::vector<int> due_;             // scratch of due heap indices
+    std::vector<int> stack_;           // scratch of heap traversal
+    int dead_ = 0;                    // count of tombstones in heap
+    double compact_ratio_ = 0.5;
 };
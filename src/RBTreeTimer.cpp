@@ -5,7 +5,11 @@
 #include "Clock.h"
 
 
-RBTreeTimer::RBTreeTimer()
+// don't bother to compact a small tree
+const int MIN_COMPACT_DEAD = 64;
+
+RBTreeTimer::RBTreeTimer(bool lazy_cancel)
+    : lazy_cancel_(lazy_cancel)
 {
 }
 
@@ -19,62 +23,88 @@ void RBTreeTimer::clear()
 {
     timers_.clear();
     ref_.clear();
+    dead_ = 0;
 }
 
-int RBTreeTimer::Start(uint32_t duration, TimeoutAction action)
+// erase all stale entries in O(N)
+void RBTreeTimer::compact()
+{
+    for (auto iter = timers_.begin(); iter != timers_.end(); ) {
+        if (ref_.count(iter->first.id) == 0) {
+            iter = timers_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    dead_ = 0;
+}
+
+int RBTreeTimer::add(int64_t deadline, TimeoutAction&& action, uint64_t cookie)
 {
     int id = nextId();
     NodeKey key;
     key.id = id;
-    key.deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
-    timers_.insert(std::make_pair(key, action));
+    key.deadline = deadline;
+    key.cookie = cookie;
+    timers_.insert(std::make_pair(key, std::move(action)));
     ref_[id] = key;
     return id;
 }
 
+int RBTreeTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, std::move(action), 0);
+}
+
+int RBTreeTimer::StartPoll(uint32_t duration, uint64_t cookie)
+{
+    return add(Clock::CurrentTimeMillis() + (int64_t)duration, nullptr, cookie);
+}
+
+int RBTreeTimer::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    return add(deadline, std::move(action), 0);
+}
+
 bool RBTreeTimer::Cancel(int timer_id)
 {
     auto iter = ref_.find(timer_id);
     if (iter != ref_.end()) {
         NodeKey key = iter->second;
         ref_.erase(iter);
+        if (lazy_cancel_) {
+            // leave entry in tree, it is stale without id, release captures of callback now
+            auto node = timers_.find(key);
+            if (node != timers_.end()) {
+                node->second = nullptr;
+            }
+            dead_++;
+            if (ref_.empty() || (dead_ >= MIN_COMPACT_DEAD && dead_ > (int)ref_.size())) {
+                compact();
+            }
+            return true;
+        }
         timers_.erase(key);
         return true;
     }
-    return false;
+    return cancelExpired(timer_id);
 }
 
 int RBTreeTimer::Update(int64_t now)
 {
-    if (timers_.size() == 0) {
-        return 0;
-    }
     auto iter = timers_.begin();
-    int fired = 0;
-    int max_id = next_id_;
-    while (timers_.size() > 0 && iter != timers_.end())
+    while (iter != timers_.end())
     {
         const NodeKey& key = iter->first;
-        if (now < key.deadline) {
+        if (now < key.deadline || collectStopped()) {
             break; // no more due timer to trigger
         }
-        // make sure we don't process newly created timer in timeout event
-        if (key.id > max_id) {
-            break;
-        }
-
-        TimeoutAction action = std::move(iter->second);
-        ref_.erase(key.id);
-        timers_.erase(key);
-
-        if (action) {
-            action(); // timeout action
-            fired++;
-        }
-
-        if (timers_.size() > 0) {
-            iter = timers_.begin();
+        if (ref_.erase(key.id) == 0) {
+            dead_--; // canceled lazily
+        } else {
+            collectExpired(key.id, key.deadline, key.cookie, std::move(iter->second));
         }
+        iter = timers_.erase(iter);
     }
-    return fired;
+    return dispatchExpired();
 }
@@ -8,6 +8,12 @@
 #include <unordered_map>
 
 // timer scheduler implemented by red-black tree.
+//
+// with `lazy_cancel`, Cancel drops the id from index and releases the callback, the entry
+// stays in tree without rebalancing,
+// a surfacing entry without id is discarded, and the tree is compacted
+// once stale entries outnumber pending ones or none is pending.
+//
 // complexity:
 //      StartTimer  CancelTimer   PerTick
 //       O(logN)     O(logN)      O(logN)
@@ -19,7 +25,8 @@ public:
     {
         int id = 0;
         int64_t deadline = 0;
-        
+        uint64_t cookie = 0;    // user cookie of poll mode, not part of order
+
         bool operator < (const NodeKey& b) const
         {
             if (deadline == b.deadline) {
@@ -30,7 +37,7 @@ public:
     };
 
 public:
-    RBTreeTimer();
+    explicit RBTreeTimer(bool lazy_cancel = false);
     ~RBTreeTimer();
 
     TimerSchedType Type() const override
@@ -38,24 +45,44 @@ public:
         return TimerSchedType::TIMER_RBTREE;
     }
 
+    using TimerBase::Start;
+
     // start a timer after `duration` milliseconds
     int Start(uint32_t duration, TimeoutAction action) override;
 
+    // start a timer for `PollExpired()`
+    int StartPoll(uint32_t duration, uint64_t cookie) override;
+
     // cancel a timer
     bool Cancel(int timer_id) override;
 
+    using TimerBase::Update;
+
     int Update(int64_t now = 0) override;
 
     int Size() const override 
     { 
-        return (int)timers_.size();
+        return (int)ref_.size();
     }
 
+    // count of canceled timers still in tree, lazy cancel only
+    int DeadCount() const
+    {
+        return dead_;
+    }
+
+protected:
+    int startAt(int64_t deadline, TimeoutAction&& action) override;
+
 private:
+    int add(int64_t deadline, TimeoutAction&& action, uint64_t cookie);
     void clear();
+    void compact();
 
     // rbtree map implementation
     std::multimap<NodeKey, TimeoutAction> timers_;
     std::unordered_map<int , NodeKey> ref_;
+    bool lazy_cancel_ = false;
+    int dead_ = 0;      // count of stale entries in tree
 };
 
@@ -0,0 +1,74 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// bounded lock-free queue of a single producer and a single consumer.
+//
+// head and tail are owned by one side each, every side caches the other's index,
+// so an uncontended push or pop touches no shared cache line.
+template <typename T>
+class SPSCQueue
+{
+public:
+    // `capacity` is rounded up to power of 2
+    explicit SPSCQueue(int capacity)
+    {
+        size_t size = 2;
+        while (size < (size_t)capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new T[size]);
+    }
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // push by the producer thread only, return false if queue is full
+    bool TryPush(T&& value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return false;
+            }
+        }
+        cells_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pop by the consumer thread only, return false if queue is empty
+    bool TryPop(T& value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        value = std::move(cells_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // explicit padding, C++11 `new` would drop an `alignas(64)` of the members
+    std::unique_ptr<T[]> cells_;
+    size_t mask_ = 0;
+    char pad0_[64 - sizeof(size_t)];
+    std::atomic<size_t> head_{0};               // written by consumer
+    size_t tail_cache_ = 0;                     // consumer's view of tail
+    char pad1_[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> tail_{0};               // written by producer
+    size_t head_cache_ = 0;                     // producer's view of head
+    char pad2_[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
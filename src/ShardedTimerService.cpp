@@ -0,0 +1,240 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "ShardedTimerService.h"
+#include "Clock.h"
+#include "Logging.h"
+#include <chrono>
+
+const int SHARD_BITS = 6;                       // at most 64 shards
+const int SHARD_MASK = (1 << SHARD_BITS) - 1;
+
+enum {
+    SHARD_START = 1,
+    SHARD_CANCEL = 2,
+};
+
+static thread_local const ShardedTimerService* current_service = nullptr;
+static thread_local int current_shard = -1;
+
+// counters are written by owner worker only
+static inline void bump(std::atomic<int64_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+ShardedTimerService::ShardedTimerService(int shards, TimerSchedType type, int queue_capacity)
+{
+    if (shards < 1 || shards > SHARD_MASK + 1) {
+        LOG(FATAL) << "invalid shard count: " << shards;
+    }
+    for (int i = 0; i < shards; i++) {
+        Shard* shard = new Shard;
+        shard->timer = CreateTimer(type);
+        for (int j = 0; j < shards; j++) {
+            shard->rings.emplace_back(new SPSCQueue<ShardCommand>(queue_capacity));
+        }
+        shard->inbox.reset(new MPSCQueue<ShardCommand>(queue_capacity));
+        shards_.emplace_back(shard);
+    }
+}
+
+ShardedTimerService::~ShardedTimerService()
+{
+    Shutdown();
+}
+
+void ShardedTimerService::Run()
+{
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    stop_ = false;
+    for (int i = 0; i < (int)shards_.size(); i++) {
+        shards_[i]->thread = std::thread(&ShardedTimerService::workerLoop, this, i);
+    }
+}
+
+void ShardedTimerService::Shutdown()
+{
+    if (!running_) {
+        return;
+    }
+    stop_ = true;
+    for (auto& shard : shards_) {
+        shard->thread.join();
+    }
+    running_ = false;
+}
+
+int ShardedTimerService::ShardOf(int64_t timer_id)
+{
+    return (int)(timer_id & SHARD_MASK);
+}
+
+int ShardedTimerService::CurrentShard() const
+{
+    return current_service == this ? current_shard : -1;
+}
+
+ShardStats ShardedTimerService::Stats(int shard) const
+{
+    ShardStats stats;
+    const Shard& s = *shards_[shard];
+    stats.starts = s.starts.load(std::memory_order_relaxed);
+    stats.cancels = s.cancels.load(std::memory_order_relaxed);
+    stats.fires = s.fires.load(std::memory_order_relaxed);
+    return stats;
+}
+
+int64_t ShardedTimerService::nextId(int shard)
+{
+    int64_t seq = shards_[shard]->next_seq.fetch_add(1, std::memory_order_relaxed);
+    return ((seq + 1) << SHARD_BITS) | shard;
+}
+
+void ShardedTimerService::send(int from, int to, ShardCommand&& cmd)
+{
+    Shard& target = *shards_[to];
+    if (from >= 0) {
+        while (!target.rings[from]->TryPush(std::move(cmd))) {
+            if (stop_.load(std::memory_order_relaxed)) {
+                return; // target may have stopped, drop it
+            }
+            drain(from); // target may be waiting on us
+            std::this_thread::yield();
+        }
+    } else {
+        while (!target.inbox->TryPush(std::move(cmd))) {
+            if (stop_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+int64_t ShardedTimerService::Start(uint32_t duration, TimeoutAction action)
+{
+    int shard = CurrentShard();
+    if (shard < 0) {
+        shard = (int)((unsigned)round_robin_.fetch_add(1, std::memory_order_relaxed) % shards_.size());
+    }
+    return StartOn(shard, duration, std::move(action));
+}
+
+int64_t ShardedTimerService::StartOn(int shard, uint32_t duration, TimeoutAction action)
+{
+    int64_t id = nextId(shard);
+    int64_t deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
+    int current = CurrentShard();
+    if (current == shard) {
+        schedule(shard, id, deadline, std::move(action));
+    } else {
+        ShardCommand cmd;
+        cmd.op = SHARD_START;
+        cmd.id = id;
+        cmd.deadline = deadline;
+        cmd.action = std::move(action);
+        send(current, shard, std::move(cmd));
+    }
+    return id;
+}
+
+bool ShardedTimerService::Cancel(int64_t timer_id)
+{
+    int shard = ShardOf(timer_id);
+    if (shard >= (int)shards_.size()) {
+        return false;
+    }
+    int current = CurrentShard();
+    if (current == shard) {
+        return cancel(shard, timer_id);
+    }
+    ShardCommand cmd;
+    cmd.op = SHARD_CANCEL;
+    cmd.id = timer_id;
+    send(current, shard, std::move(cmd));
+    return true;
+}
+
+void ShardedTimerService::schedule(int shard, int64_t id, int64_t deadline, TimeoutAction&& action)
+{
+    Shard& s = *shards_[shard];
+    int64_t now = Clock::CurrentTimeMillis();
+    uint32_t duration = deadline > now ? (uint32_t)(deadline - now) : 0;
+    Entry& entry = s.ref[id];
+    entry.action = std::move(action);
+    entry.inner_id = s.timer->Start(duration, [this, shard, id]() {
+        fire(shard, id);
+    });
+    bump(s.starts);
+}
+
+bool ShardedTimerService::cancel(int shard, int64_t id)
+{
+    Shard& s = *shards_[shard];
+    auto iter = s.ref.find(id);
+    if (iter == s.ref.end()) {
+        return false;
+    }
+    s.timer->Cancel(iter->second.inner_id);
+    s.ref.erase(iter);
+    bump(s.cancels);
+    return true;
+}
+
+void ShardedTimerService::fire(int shard, int64_t id)
+{
+    Shard& s = *shards_[shard];
+    auto iter = s.ref.find(id);
+    if (iter == s.ref.end()) {
+        return;
+    }
+    TimeoutAction action = std::move(iter->second.action);
+    s.ref.erase(iter);
+    bump(s.fires);
+    if (action) {
+        action();
+    }
+}
+
+// apply commands sent to `shard`
+int ShardedTimerService::drain(int shard)
+{
+    Shard& s = *shards_[shard];
+    int count = 0;
+    ShardCommand cmd;
+    for (int i = 0; i <= (int)s.rings.size(); i++) {
+        for (;;) {
+            bool ok = i < (int)s.rings.size() ? s.rings[i]->TryPop(cmd) : s.inbox->TryPop(cmd);
+            if (!ok) {
+                break;
+            }
+            if (cmd.op == SHARD_START) {
+                schedule(shard, cmd.id, cmd.deadline, std::move(cmd.action));
+            } else {
+                cancel(shard, cmd.id);
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+void ShardedTimerService::workerLoop(int shard)
+{
+    current_service = this;
+    current_shard = shard;
+    TimerBase* timer = shards_[shard]->timer.get();
+    while (!stop_.load(std::memory_order_relaxed)) {
+        int count = drain(shard);
+        count += timer->Update(Clock::CurrentTimeMillis());
+        if (count == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    current_service = nullptr;
+    current_shard = -1;
+}
@@ -0,0 +1,111 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "MPSCQueue.h"
+#include "SPSCQueue.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+
+// counters of a shard, updated by its worker thread
+struct ShardStats
+{
+    int64_t starts = 0;
+    int64_t cancels = 0;
+    int64_t fires = 0;
+};
+
+// a Start or Cancel sent to another shard
+struct ShardCommand
+{
+    int op = 0;             // SHARD_START or SHARD_CANCEL
+    int64_t id = 0;
+    int64_t deadline = 0;
+    TimeoutAction action = nullptr;
+};
+
+// thread-per-core timer service, one scheduler per worker thread.
+//
+// the shard index is encoded in low bits of a 64-bit timer id, so `Cancel` from any thread
+// routes to the owner, and ids of a shard never wrap onto a pending timer. calls made on the owner worker are direct calls,
+// a worker sends to another shard through a SPSC ring of the (from, to) pair,
+// and a non-worker thread through a MPSC inbox of the target shard.
+//
+// commands of one thread to one shard are applied in order, so a thread may cancel
+// a timer it just started on another shard. callbacks run on the owner worker.
+class ShardedTimerService
+{
+public:
+    ShardedTimerService(int shards, TimerSchedType type, int queue_capacity = 4096);
+    ~ShardedTimerService();
+
+    ShardedTimerService(const ShardedTimerService&) = delete;
+    ShardedTimerService& operator=(const ShardedTimerService&) = delete;
+
+    // start worker threads
+    void Run();
+
+    // stop and join worker threads, pending timers are dropped
+    void Shutdown();
+
+    // start a timer on current shard, or a round-robin shard if called by non-worker
+    int64_t Start(uint32_t duration, TimeoutAction action);
+
+    // start a timer on given shard
+    int64_t StartOn(int shard, uint32_t duration, TimeoutAction action);
+
+    // cancel a timer from any thread.
+    // a call routed to another shard gets true once the command is queued.
+    bool Cancel(int64_t timer_id);
+
+    int ShardCount() const
+    {
+        return (int)shards_.size();
+    }
+
+    // shard of calling worker thread, -1 if not a worker of this service
+    int CurrentShard() const;
+
+    // counters of a shard, exact after `Shutdown()`
+    ShardStats Stats(int shard) const;
+
+    static int ShardOf(int64_t timer_id);
+
+private:
+    struct Entry
+    {
+        int inner_id = 0;           // id at shard scheduler
+        TimeoutAction action = nullptr;
+    };
+
+    struct Shard
+    {
+        std::shared_ptr<TimerBase> timer;
+        std::unordered_map<int64_t, Entry> ref;                     // service id to entry
+        std::vector<std::unique_ptr<SPSCQueue<ShardCommand>>> rings; // indexed by sender shard
+        std::unique_ptr<MPSCQueue<ShardCommand>> inbox;             // from non-worker threads
+        std::atomic<int64_t> next_seq{0};
+        std::atomic<int64_t> starts{0};
+        std::atomic<int64_t> cancels{0};
+        std::atomic<int64_t> fires{0};
+        std::thread thread;
+    };
+
+    int64_t nextId(int shard);
+    void send(int from, int to, ShardCommand&& cmd);
+    void schedule(int shard, int64_t id, int64_t deadline, TimeoutAction&& action);
+    bool cancel(int shard, int64_t id);
+    void fire(int shard, int64_t id);
+    int drain(int shard);
+    void workerLoop(int shard);
+
+private:
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<bool> stop_{false};
+    std::atomic<int> round_robin_{0};
+    bool running_ = false;
+};
@@ -0,0 +1,167 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "StripedTimer.h"
+#include "Clock.h"
+#include "Logging.h"
+#include <algorithm>
+#include <thread>
+
+const int STRIPE_BITS = 6;                      // at most 64 stripes
+const int STRIPE_MASK = (1 << STRIPE_BITS) - 1;
+const int CLAIM_BATCH = 256;                    // max timers claimed per stripe lock
+
+static std::atomic<int> thread_counter(0);
+static thread_local int thread_index = -1;
+
+// a small index of calling thread, shared by all instances
+static int threadIndex()
+{
+    if (thread_index < 0) {
+        thread_index = thread_counter.fetch_add(1, std::memory_order_relaxed) & INT_MAX;
+    }
+    return thread_index;
+}
+
+StripedTimer::StripedTimer(int stripes)
+{
+    if (stripes == 0) {
+        stripes = (int)std::thread::hardware_concurrency();
+        stripes = std::max(1, std::min(stripes, STRIPE_MASK + 1));
+    }
+    if (stripes < 1 || stripes > STRIPE_MASK + 1) {
+        LOG(FATAL) << "invalid stripe count: " << stripes;
+    }
+    for (int i = 0; i < stripes; i++) {
+        stripes_.emplace_back(new Stripe);
+        stripes_.back()->heap.reserve(64); // reserve a little space
+    }
+}
+
+StripedTimer::~StripedTimer()
+{
+    for (auto& stripe : stripes_) {
+        for (auto& kv : stripe->ref) {
+            delete kv.second;
+        }
+    }
+}
+
+int StripedTimer::StripeOf(int64_t timer_id)
+{
+    return (int)(timer_id & STRIPE_MASK);
+}
+
+int StripedTimer::CurrentStripe() const
+{
+    return threadIndex() % (int)stripes_.size();
+}
+
+int64_t StripedTimer::NextDeadline() const
+{
+    int64_t deadline = INT64_MAX;
+    for (auto& stripe : stripes_) {
+        deadline = std::min(deadline, stripe->min_deadline.load(std::memory_order_acquire));
+    }
+    return deadline == INT64_MAX ? -1 : deadline;
+}
+
+// by lock holder only
+void StripedTimer::publish(Stripe& stripe)
+{
+    int64_t deadline = stripe.heap.empty() ? INT64_MAX : stripe.heap.top()->deadline;
+    stripe.min_deadline.store(deadline, std::memory_order_release);
+}
+
+int64_t StripedTimer::Start(uint32_t duration, TimeoutAction action)
+{
+    int index = CurrentStripe();
+    Stripe& stripe = *stripes_[index];
+    StripedTimerNode* node = new StripedTimerNode;
+    node->deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
+    node->action = std::move(action);
+
+    std::lock_guard<std::mutex> guard(stripe.mutex);
+    int64_t seq = stripe.next_seq++;
+    node->id = ((seq + 1) << STRIPE_BITS) | index;
+    stripe.heap.push(node);
+    stripe.ref[node->id] = node;
+    if (node->deadline < stripe.min_deadline.load(std::memory_order_relaxed)) {
+        publish(stripe);
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return node->id;
+}
+
+bool StripedTimer::Cancel(int64_t timer_id)
+{
+    int index = StripeOf(timer_id);
+    if (timer_id <= 0 || index >= (int)stripes_.size()) {
+        return false;
+    }
+    Stripe& stripe = *stripes_[index];
+    StripedTimerNode* node = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(stripe.mutex);
+        auto iter = stripe.ref.find(timer_id);
+        if (iter == stripe.ref.end()) {
+            return false;
+        }
+        node = iter->second;
+        stripe.ref.erase(iter);
+        bool first = stripe.heap.top() == node;
+        stripe.heap.remove(node);
+        if (first) {
+            publish(stripe);
+        }
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    delete node; // release captures out of lock
+    return true;
+}
+
+// pop due timers of a locked stripe
+void StripedTimer::claim(Stripe& stripe, int64_t now, std::vector<TimeoutAction>& actions)
+{
+    int count = 0;
+    while (!stripe.heap.empty() && count < CLAIM_BATCH) {
+        StripedTimerNode* node = stripe.heap.top();
+        if (now < node->deadline) {
+            break;
+        }
+        stripe.heap.pop();
+        stripe.ref.erase(node->id);
+        actions.push_back(std::move(node->action));
+        delete node;
+        count++;
+    }
+    publish(stripe);
+    size_.fetch_sub(count, std::memory_order_relaxed);
+}
+
+int StripedTimer::Update(int64_t now)
+{
+    int n = (int)stripes_.size();
+    int start = threadIndex() % n; // own stripe first, spread workers
+    int fired = 0;
+    std::vector<TimeoutAction> actions;
+    for (int i = 0; i < n; i++) {
+        Stripe& stripe = *stripes_[(start + i) % n];
+        while (stripe.min_deadline.load(std::memory_order_acquire) <= now) {
+            std::unique_lock<std::mutex> lock(stripe.mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                break; // claimed by another worker
+            }
+            claim(stripe, now, actions);
+            lock.unlock();
+            for (auto& action : actions) {
+                if (action) {
+                    action();
+                }
+            }
+            fired += (int)actions.size();
+            actions.clear();
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,101 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include "DAryHeap.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+struct StripedTimerNode
+{
+    int index = -1;         // array index at heap
+    int64_t id = 0;         // unique timer id
+    int64_t deadline = 0;   // expired time in ms
+    TimeoutAction action = nullptr;
+};
+
+struct StripedTimerNodeLess
+{
+    bool operator()(const StripedTimerNode* a, const StripedTimerNode* b) const
+    {
+        if (a->deadline == b->deadline) {
+            return a->id < b->id;
+        }
+        return a->deadline < b->deadline;
+    }
+};
+
+// timer scheduler shared by a pool of workers which all call `Update()`.
+//
+// timers are spread over K independently locked 4-ary heaps(stripes), a thread always
+// starts timers on the same stripe, and the stripe is encoded in low 6 bits of a 64-bit
+// timer id so `Cancel` locks only that stripe, ids of a stripe never wrap onto a pending timer.
+// each stripe publishes its earliest deadline in an atomic of its own cache line,
+// a worker scans these without lock and claims a ripe stripe by `try_lock`, so workers
+// never wait on each other. due timers are popped under the stripe lock and
+// callbacks run on the claiming worker after unlock, they may start or cancel timers.
+//
+// a timer claimed by a worker but not run yet can not be canceled.
+class StripedTimer
+{
+public:
+    // `stripes` of 0 means one per hardware thread, at most 64
+    explicit StripedTimer(int stripes = 0);
+    ~StripedTimer();
+
+    StripedTimer(const StripedTimer&) = delete;
+    StripedTimer& operator=(const StripedTimer&) = delete;
+
+    // start a timer after `duration` milliseconds on stripe of calling thread
+    int64_t Start(uint32_t duration, TimeoutAction action);
+
+    // cancel a timer from any thread
+    bool Cancel(int64_t timer_id);
+
+    // claim due timers of ripe stripes and run them, from any worker thread.
+    // return number of fired timers
+    int Update(int64_t now);
+
+    // count of pending timers
+    int Size() const
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    // earliest deadline of all stripes, or -1 if no pending timer
+    int64_t NextDeadline() const;
+
+    int StripeCount() const
+    {
+        return (int)stripes_.size();
+    }
+
+    // stripe of calling thread
+    int CurrentStripe() const;
+
+    static int StripeOf(int64_t timer_id);
+
+private:
+    // padded rather than `alignas(64)`, which `new` ignores under C++11
+    struct Stripe
+    {
+        std::atomic<int64_t> min_deadline{INT64_MAX};   // published under `mutex`
+        char pad0[64 - sizeof(std::atomic<int64_t>)];   // polled by all workers, apart from lock
+        std::mutex mutex;
+        DAryHeap<4, StripedTimerNode, StripedTimerNodeLess> heap;
+        std::unordered_map<int64_t, StripedTimerNode*> ref;
+        int64_t next_seq = 0;
+        char pad1[64];                                  // apart from next stripe
+    };
+
+    void publish(Stripe& stripe);
+    void claim(Stripe& stripe, int64_t now, std::vector<TimeoutAction>& actions);
+
+private:
+    std::vector<std::unique_ptr<Stripe>> stripes_;
+    std::atomic<int> size_{0};
+};
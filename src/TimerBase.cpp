@@ -7,6 +7,21 @@
 #include "RBTreeTimer.h"
 #include "HashedWheelTimer.h"
 #include "HHWheelTimer.h"
+#include "IntrusiveRBTreeTimer.h"
+#include "DAryHeapTimer.h"
+#include "CoalescedHeapTimer.h"
+#include "DurationQueueTimer.h"
+#include "HybridWheelTimer.h"
+#include "AdaptiveTimer.h"
+#include "BufferedHeapTimer.h"
+#include "PrecisionTimer.h"
+#include "CommandQueueTimer.h"
+#include "ConcurrentHashedWheelTimer.h"
+#include "TimerExecutor.h"
+#include "Clock.h"
+#include <algorithm>
+
+const int BATCH_SCAN_LIMIT = 16;    // cancel in a smaller batch by linear scan
 
 TimerBase::TimerBase()
 {
@@ -21,6 +36,274 @@ int TimerBase::nextId()
     return next_id_++; // we do no duplicate checking here
 }
 
+int64_t TimerBase::AlignDeadline(int64_t deadline, uint32_t slack)
+{
+    if (slack == 0) {
+        return deadline;
+    }
+    int64_t granularity = 1;
+    while (granularity * 2 <= (int64_t)slack) {
+        granularity *= 2;
+    }
+    return (deadline + slack) & ~(granularity - 1);
+}
+
+int TimerBase::Start(uint32_t ms, TimeoutAction action, uint32_t slack)
+{
+    int64_t deadline = AlignDeadline(Clock::CurrentTimeMillis() + (int64_t)ms, slack);
+    return startAt(deadline, std::move(action));
+}
+
+int TimerBase::startAt(int64_t deadline, TimeoutAction&& action)
+{
+    int64_t now = Clock::CurrentTimeMillis();
+    return Start(deadline > now ? (uint32_t)(deadline - now) : 0, std::move(action));
+}
+
+// stable sort each run of same deadline by callable type,
+// sort (type, position) keys then move timers once.
+void TimerBase::groupExpired()
+{
+    int n = (int)expired_batch_.size();
+    group_keys_.resize(n);
+    for (int i = 0; i < n; i++) {
+        group_keys_[i].first = expired_batch_[i].action.target_type().hash_code();
+        group_keys_[i].second = i;
+    }
+    for (int first = 0; first < n; ) {
+        int last = first + 1;
+        while (last < n && expired_batch_[last].deadline == expired_batch_[first].deadline) {
+            last++;
+        }
+        if (last - first > 2) {
+            std::sort(group_keys_.begin() + first, group_keys_.begin() + last);
+        }
+        first = last;
+    }
+    std::vector<ExpiredTimer> grouped;
+    grouped.swap(group_scratch_);
+    grouped.reserve(n);
+    for (int i = 0; i < n; i++) {
+        grouped.push_back(std::move(expired_batch_[group_keys_[i].second]));
+    }
+    expired_batch_.swap(grouped);
+    grouped.clear();
+    group_scratch_.swap(grouped); // reuse capacity
+    batch_index_.clear();
+    batch_indexed_ = 0;
+}
+
+void TimerBase::resetExpired()
+{
+    expired_batch_.clear(); // reuse capacity
+    batch_index_.clear();
+    batch_indexed_ = 0;
+    batch_pos_ = 0;
+}
+
+// run at most `limit` collected callbacks before `deadline_ns`
+int TimerBase::runExpired(int limit, int64_t deadline_ns)
+{
+    if (dispatch_grouping_ && batch_pos_ == 0) {
+        groupExpired();
+    }
+    if (executor_) {
+        return handoffExpired(limit);
+    }
+    dispatching_ = true;
+    int fired = 0;
+    while (batch_pos_ < (int)expired_batch_.size() && fired < limit) {
+        ExpiredTimer& timer = expired_batch_[batch_pos_++];
+        if (timer.id == 0) {
+            continue; // canceled by previous callback
+        }
+        auto action = std::move(timer.action);
+        fired++;
+        if (action) {
+            action(); // may append to or cancel in `expired_batch_`
+        }
+        if (deadline_ns != INT64_MAX && Clock::GetNowTickCount() >= deadline_ns) {
+            break;
+        }
+    }
+    dispatching_ = false;
+    if (batch_pos_ >= (int)expired_batch_.size()) {
+        resetExpired();
+    }
+    return fired;
+}
+
+// move at most `limit` collected callbacks to executor as one batch
+int TimerBase::handoffExpired(int limit)
+{
+    int fired = 0;
+    while (batch_pos_ < (int)expired_batch_.size() && fired < limit) {
+        ExpiredTimer& timer = expired_batch_[batch_pos_++];
+        if (timer.id == 0) {
+            continue;
+        }
+        handoff_.push_back(std::move(timer.action));
+        fired++;
+    }
+    executor_->Submit(handoff_);
+    if (batch_pos_ >= (int)expired_batch_.size()) {
+        resetExpired();
+    }
+    return fired;
+}
+
+int TimerBase::dispatchExpired()
+{
+    if (dispatching_) {
+        return 0; // nested update, outer loop will dispatch new timers
+    }
+    if (polling_) {
+        return ExpiredBacklog();
+    }
+    return runExpired(INT_MAX, INT64_MAX);
+}
+
+bool TimerBase::checkCollectBudget()
+{
+    if ((int)expired_batch_.size() - batch_pos_ >= collect_limit_ ||
+        Clock::GetNowTickCount() >= budget_deadline_ns_) {
+        collect_stopped_ = true;
+    }
+    return collect_stopped_;
+}
+
+UpdateResult TimerBase::Update(int64_t now, const UpdateBudget& budget)
+{
+    UpdateResult result;
+    if (dispatching_ || polling_) {
+        return result; // not reentrant
+    }
+    budget_deadline_ns_ = INT64_MAX;
+    if (budget.max_ns > 0) {
+        budget_deadline_ns_ = Clock::GetNowTickCount() + budget.max_ns;
+    }
+    // carried over timers first
+    result.fired = runExpired(budget.max_fired, budget_deadline_ns_);
+    collect_stopped_ = false;
+    if (ExpiredBacklog() == 0 && result.fired < budget.max_fired &&
+        Clock::GetNowTickCount() < budget_deadline_ns_) {
+        collect_bounded_ = true;
+        collect_limit_ = budget.max_fired - result.fired;
+        polling_ = true;
+        Update(now); // collect only
+        polling_ = false;
+        collect_bounded_ = false;
+        collect_limit_ = INT_MAX;
+        result.fired += runExpired(budget.max_fired - result.fired, budget_deadline_ns_);
+    } else {
+        collect_stopped_ = true;
+    }
+    result.backlog = ExpiredBacklog();
+    result.stopped = collect_stopped_ || result.backlog > 0;
+    budget_deadline_ns_ = INT64_MAX;
+    return result;
+}
+
+void TimerBase::collectInner(TimerBase* inner, int64_t now)
+{
+    if (collect_bounded_) {
+        // pass remaining budget down
+        inner->collect_bounded_ = true;
+        inner->collect_limit_ = collect_limit_ - ExpiredBacklog();
+        inner->budget_deadline_ns_ = budget_deadline_ns_;
+        inner->collect_stopped_ = false;
+    }
+    inner->polling_ = true;
+    inner->Update(now);
+    inner->polling_ = false;
+    if (inner->collect_bounded_) {
+        collect_stopped_ = collect_stopped_ || inner->collect_stopped_;
+        inner->collect_bounded_ = false;
+        inner->collect_limit_ = INT_MAX;
+        inner->budget_deadline_ns_ = INT64_MAX;
+    }
+    for (int i = inner->batch_pos_; i < (int)inner->expired_batch_.size(); i++) {
+        ExpiredTimer& timer = inner->expired_batch_[i];
+        if (timer.id != 0) {
+            collectExpired(timer.id, timer.deadline, timer.cookie, std::move(timer.action));
+        }
+    }
+    inner->resetExpired();
+}
+
+void TimerBase::sortExpired()
+{
+    std::stable_sort(expired_batch_.begin() + batch_pos_, expired_batch_.end(),
+        [](const ExpiredTimer& a, const ExpiredTimer& b) {
+            if (a.deadline == b.deadline) {
+                return a.id < b.id;
+            }
+            return a.deadline < b.deadline;
+        });
+    batch_index_.clear();
+    batch_indexed_ = 0;
+}
+
+bool TimerBase::cancelExpired(int timer_id)
+{
+    int n = (int)expired_batch_.size();
+    if (batch_pos_ >= n) {
+        return false;
+    }
+    int pos = -1;
+    if (n - batch_pos_ <= BATCH_SCAN_LIMIT) {
+        for (int i = batch_pos_; i < n; i++) {
+            if (expired_batch_[i].id == timer_id) {
+                pos = i;
+                break;
+            }
+        }
+    } else {
+        for (; batch_indexed_ < n; batch_indexed_++) {
+            batch_index_[expired_batch_[batch_indexed_].id] = batch_indexed_; // index new timers only
+        }
+        auto iter = batch_index_.find(timer_id);
+        if (iter != batch_index_.end() && iter->second >= batch_pos_) {
+            pos = iter->second;
+        }
+    }
+    if (pos < 0 || expired_batch_[pos].id == 0) {
+        return false;
+    }
+    expired_batch_[pos].id = 0;
+    expired_batch_[pos].action = nullptr;
+    return true;
+}
+
+int TimerBase::PollExpired(int64_t now, ExpiredEntry* out, int capacity)
+{
+    if (dispatching_ || polling_) {
+        return 0; // not reentrant
+    }
+    int n = 0;
+    for (int round = 0; round < 2 && n < capacity; round++) {
+        if (round > 0) {
+            // carry-over drained, collect timers due at `now`
+            resetExpired();
+            polling_ = true;
+            Update(now);
+            polling_ = false;
+        }
+        while (n < capacity && batch_pos_ < (int)expired_batch_.size()) {
+            ExpiredTimer& timer = expired_batch_[batch_pos_++];
+            if (timer.id == 0) {
+                continue; // canceled after collected
+            }
+            out[n].id = timer.id;
+            out[n].cookie = timer.cookie;
+            n++;
+        }
+    }
+    if (batch_pos_ >= (int)expired_batch_.size()) {
+        resetExpired();
+    }
+    return n;
+}
 
 std::shared_ptr<TimerBase> CreateTimer(TimerSchedType sched_type)
 {
@@ -36,6 +319,26 @@ std::shared_ptr<TimerBase> CreateTimer(TimerSchedType sched_type)
         return std::shared_ptr<TimerBase>(new HashedWheelTimer());
     case TimerSchedType::TIMER_HH_WHEEL:
         return std::shared_ptr<TimerBase>(new HHWheelTimer());
+    case TimerSchedType::TIMER_INTRUSIVE_RBTREE:
+        return std::shared_ptr<TimerBase>(new IntrusiveRBTreeTimer());
+    case TimerSchedType::TIMER_DARY_HEAP:
+        return std::shared_ptr<TimerBase>(new DAryHeapTimer<4>());
+    case TimerSchedType::TIMER_COALESCED_HEAP:
+        return std::shared_ptr<TimerBase>(new CoalescedHeapTimer());
+    case TimerSchedType::TIMER_DURATION_QUEUE:
+        return std::shared_ptr<TimerBase>(new DurationQueueTimer());
+    case TimerSchedType::TIMER_HYBRID_WHEEL:
+        return std::shared_ptr<TimerBase>(new HybridWheelTimer());
+    case TimerSchedType::TIMER_ADAPTIVE:
+        return std::shared_ptr<TimerBase>(new AdaptiveTimer());
+    case TimerSchedType::TIMER_BUFFERED_HEAP:
+        return std::shared_ptr<TimerBase>(new BufferedHeapTimer());
+    case TimerSchedType::TIMER_PRECISION:
+        return std::shared_ptr<TimerBase>(new PrecisionTimer());
+    case TimerSchedType::TIMER_COMMAND_QUEUE:
+        return std::shared_ptr<TimerBase>(new CommandQueueTimer());
+    case TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL:
+        return std::shared_ptr<TimerBase>(new ConcurrentHashedWheelTimer());
     default:
         return nullptr;
     }
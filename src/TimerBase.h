@@ -4,8 +4,11 @@
 #pragma once
 
 #include <stdint.h>
+#include <limits.h>
 #include <memory>
 #include <functional>
+#include <vector>
+#include <unordered_map>
 
 
 enum class TimerSchedType
@@ -15,11 +18,54 @@ enum class TimerSchedType
     TIMER_RBTREE = 3,
     TIMER_HASHED_WHEEL = 4,
     TIMER_HH_WHEEL = 5,
+    TIMER_INTRUSIVE_RBTREE = 6,
+    TIMER_DARY_HEAP = 7,
+    TIMER_COALESCED_HEAP = 8,
+    TIMER_DURATION_QUEUE = 9,
+    TIMER_HYBRID_WHEEL = 10,
+    TIMER_ADAPTIVE = 11,
+    TIMER_BUFFERED_HEAP = 12,
+    TIMER_PRECISION = 13,
+    TIMER_COMMAND_QUEUE = 14,
+    TIMER_CONCURRENT_HASHED_WHEEL = 15,
 };
 
 // expiry action
 typedef std::function<void()> TimeoutAction;
 
+class TimerExecutor;
+
+// a due timer taken out of scheduler, waiting to be dispatched
+struct ExpiredTimer
+{
+    int id = 0;             // 0 if canceled in dispatch
+    int64_t deadline = 0;
+    uint64_t cookie = 0;
+    TimeoutAction action = nullptr;
+};
+
+// limits of a bounded `Update()`
+struct UpdateBudget
+{
+    int max_fired = INT_MAX;    // max timers fired in this call
+    int64_t max_ns = 0;         // max time spent in this call, 0 for no limit
+};
+
+// outcome of a bounded `Update()`
+struct UpdateResult
+{
+    int fired = 0;              // count of fired timers
+    int backlog = 0;            // due timers collected but not fired yet
+    bool stopped = false;       // true if budget ran out, more timers may be due
+};
+
+// a due timer returned by `PollExpired()`
+struct ExpiredEntry
+{
+    int id = 0;
+    uint64_t cookie = 0;    // user cookie passed to `StartPoll()`
+};
+
 // we model 3 simple API for the construction and management of timers.
 // 
 //  1. int Start(interval, expiry_action)
@@ -48,6 +94,10 @@ public:
     // a `uint32_t` type of milliseconds means at most 49.7 days, that's good enough
     virtual int Start(uint32_t ms, TimeoutAction action) = 0;
 
+    // schedule a timer without callback for `PollExpired()`,
+    // `cookie` is returned as is when it expires.
+    virtual int StartPoll(uint32_t ms, uint64_t cookie) = 0;
+
     // cancel a timer by id
     // return true if successfully canceld
     virtual bool Cancel(int timer_id) = 0;
@@ -59,10 +109,134 @@ public:
     // count of pending timers.
     virtual int Size() const = 0;
 
+    // deadline of the earliest pending timer, may be earlier than it.
+    // -1 if no pending timer or the scheduler does not track it.
+    virtual int64_t NextDeadline() const
+    {
+        return -1;
+    }
+
+    // schedule a timer which tolerates firing up to `slack` milliseconds late,
+    // the deadline is rounded to a boundary shared with nearby timers.
+    int Start(uint32_t ms, TimeoutAction action, uint32_t slack);
+
+    // round `deadline` up within [deadline, deadline + slack] to a multiple of
+    // the largest power of 2 not above `slack`.
+    static int64_t AlignDeadline(int64_t deadline, uint32_t slack);
+
+    // bounded `Update()`, stops once the budget runs out and resumes at next call,
+    // carried over timers fire before any newly due timer.
+    UpdateResult Update(int64_t now, const UpdateBudget& budget);
+
+    // pull mode of `Update()`, write due timers into `out` in deadline order
+    // instead of invoking callbacks, return count of written entries.
+    // due timers beyond `capacity` are carried over to next call.
+    // meant for timers of `StartPoll()`, a due timer of `Start()` is written with
+    // cookie 0 and its callback is dropped. returns 0 if called from a callback.
+    int PollExpired(int64_t now, ExpiredEntry* out, int capacity);
+
+    // count of due timers carried over by `PollExpired()`
+    int ExpiredBacklog() const
+    {
+        return (int)expired_batch_.size() - batch_pos_;
+    }
+
+    // dispatch callbacks of same deadline grouped by callable type,
+    // so consecutive callbacks share instruction cache.
+    void SetDispatchGrouping(bool enable)
+    {
+        dispatch_grouping_ = enable;
+    }
+
+    // hand fired callbacks to `executor` in batches instead of running them inline,
+    // the scheduler itself stays single-threaded. nullptr restores inline dispatch.
+    void SetExecutor(std::shared_ptr<TimerExecutor> executor)
+    {
+        executor_ = std::move(executor);
+    }
+
 protected:
     int nextId();
 
+    // two-phase update, collect due timers while maintaining the structure,
+    // then run all callbacks in one tight loop.
+    void collectExpired(int id, int64_t deadline, uint64_t cookie, TimeoutAction&& action)
+    {
+        expired_batch_.emplace_back();
+        ExpiredTimer& timer = expired_batch_.back();
+        timer.id = id;
+        timer.deadline = deadline;
+        timer.cookie = cookie;
+        timer.action = std::move(action);
+    }
+
+    // run collected callbacks in collecting order, return count of dispatched timers.
+    // under `PollExpired()`, callbacks are not run and collected timers are kept.
+    int dispatchExpired();
+
+    // cancel a collected timer not dispatched yet
+    bool cancelExpired(int timer_id);
+
+    // restore (deadline, id) order of timers collected out of order
+    void sortExpired();
+
+    // true if a bounded update has collected enough, checked by collect loops
+    bool collectStopped()
+    {
+        return collect_bounded_ && checkCollectBudget();
+    }
+
+    bool collectBounded() const
+    {
+        return collect_bounded_;
+    }
+
+    // collect due timers of an inner scheduler into this batch with their ids,
+    // so callbacks of inner timers are run by dispatch of this scheduler.
+    void collectInner(TimerBase* inner, int64_t now);
+
+    // allocate id from an inner scheduler, so ids never clash with its own timers
+    static int nextIdOf(TimerBase* inner)
+    {
+        return inner->nextId();
+    }
+
+    // start a timer at an absolute `deadline` computed by caller,
+    // so the clock is read once. default converts it back to a duration.
+    virtual int startAt(int64_t deadline, TimeoutAction&& action);
+
+    friend class TimerThread; // measures lateness against the deadline it starts at
+
+    static int startAtOf(TimerBase* inner, int64_t deadline, TimeoutAction&& action)
+    {
+        return inner->startAt(deadline, std::move(action));
+    }
+
     int next_id_ = 2020;   // auto-increment timer id, with a magic  number
+
+private:
+    void groupExpired();
+    void resetExpired();
+    int runExpired(int limit, int64_t deadline_ns);
+    int handoffExpired(int limit);
+    bool checkCollectBudget();
+
+private:
+    std::vector<ExpiredTimer> expired_batch_;   // scratch of collected timers
+    std::unordered_map<int, int> batch_index_;  // id to batch position, built on demand
+    int batch_indexed_ = 0;                     // count of timers in `batch_index_`
+    std::vector<std::pair<size_t, int>> group_keys_;    // scratch of grouping
+    std::vector<ExpiredTimer> group_scratch_;
+    int batch_pos_ = 0;                         // next timer to dispatch or poll
+    bool dispatching_ = false;
+    bool polling_ = false;
+    bool dispatch_grouping_ = false;
+    bool collect_bounded_ = false;
+    bool collect_stopped_ = false;
+    int collect_limit_ = INT_MAX;
+    int64_t budget_deadline_ns_ = INT64_MAX;
+    std::shared_ptr<TimerExecutor> executor_;
+    std::vector<TimeoutAction> handoff_;        // scratch of a batch to executor
 };
 
 std::shared_ptr<TimerBase> CreateTimer(TimerSchedType sched_type);
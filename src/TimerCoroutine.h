@@ -0,0 +1,419 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+// C++20 coroutine support, build with `-DTIMER_ENABLE_COROUTINE=ON`
+#if defined(__cpp_impl_coroutine)
+
+#include "TimerBase.h"
+#include "IntrusiveRBTreeTimer.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// resumes a suspended coroutine, small enough for the local storage of `TimeoutAction`,
+// so starting it on a scheduler allocates no callback.
+struct ResumeAction
+{
+    std::coroutine_handle<> handle;
+
+    void operator()() const
+    {
+        handle.resume();
+    }
+};
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> continuation;   // awaiting coroutine, resumed on completion
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            std::coroutine_handle<> next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        exception = std::current_exception();
+    }
+
+    void rethrow() const
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    template <typename U>
+    void return_value(U&& v)
+    {
+        value.emplace(std::forward<U>(v));
+    }
+
+    T result()
+    {
+        rethrow();
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object();
+
+    void return_void()
+    {
+    }
+
+    void result()
+    {
+        rethrow();
+    }
+};
+
+} // namespace detail
+
+// lazily started coroutine, runs when awaited or `Start()`ed, the frame is destroyed with the task.
+// destroying a task suspended on a timer cancels the timer.
+template <typename T = void>
+class Task
+{
+public:
+    typedef detail::TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    Task() = default;
+
+    explicit Task(Handle h)
+        : handle_(h)
+    {
+    }
+
+    Task(Task&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        reset();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    // run a top-level task until its first suspension
+    void Start()
+    {
+        handle_.resume();
+    }
+
+    bool Done() const
+    {
+        return handle_ && handle_.done();
+    }
+
+    // result of a finished task
+    T Result()
+    {
+        return handle_.promise().result();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle_.promise().continuation = awaiting;
+        return handle_; // symmetric transfer, no stack growth
+    }
+
+    T await_resume()
+    {
+        return handle_.promise().result();
+    }
+
+    void reset()
+    {
+        if (handle_) {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+
+private:
+    template <typename U>
+    friend class TimeoutAwaiter;
+
+    Handle handle_ = nullptr;
+};
+
+namespace detail {
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// `co_await Sleep(timer, ms)` on any scheduler, resumed by `Update()` of the scheduler
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(TimerBase& timer, uint32_t duration)
+        : timer_(timer), duration_(duration)
+    {
+    }
+
+    // destroyed with a frame suspended here, cancel the timer
+    ~SleepAwaiter()
+    {
+        if (pending_) {
+            timer_.Cancel(id_);
+        }
+    }
+
+    SleepAwaiter(const SleepAwaiter&) = delete;
+    SleepAwaiter& operator=(const SleepAwaiter&) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        id_ = timer_.Start(duration_, ResumeAction{h});
+        pending_ = true;
+    }
+
+    void await_resume() noexcept
+    {
+        pending_ = false;
+    }
+
+private:
+    TimerBase& timer_;
+    uint32_t duration_ = 0;
+    int id_ = 0;
+    bool pending_ = false;
+};
+
+// `co_await Sleep(timer, ms)` on `IntrusiveRBTreeTimer`, the awaiter living in the coroutine
+// frame is the timer record, so neither a pooled record nor an id lookup is needed.
+class IntrusiveSleepAwaiter
+{
+public:
+    IntrusiveSleepAwaiter(IntrusiveRBTreeTimer& timer, uint32_t duration)
+        : timer_(timer), duration_(duration)
+    {
+    }
+
+    // destroyed with a frame suspended here, unlink the record
+    ~IntrusiveSleepAwaiter()
+    {
+        if (pending_) {
+            timer_.Unschedule(&entry_);
+        }
+    }
+
+    IntrusiveSleepAwaiter(const IntrusiveSleepAwaiter&) = delete;
+    IntrusiveSleepAwaiter& operator=(const IntrusiveSleepAwaiter&) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        entry_.action = ResumeAction{h};
+        timer_.Schedule(&entry_, duration_);
+        pending_ = true;
+    }
+
+    void await_resume() noexcept
+    {
+        pending_ = false;
+    }
+
+private:
+    IntrusiveRBTreeTimer& timer_;
+    uint32_t duration_ = 0;
+    RBTimerEntry entry_;
+    bool pending_ = false;
+};
+
+inline SleepAwaiter Sleep(TimerBase& timer, uint32_t duration)
+{
+    return SleepAwaiter(timer, duration);
+}
+
+inline IntrusiveSleepAwaiter Sleep(IntrusiveRBTreeTimer& timer, uint32_t duration)
+{
+    return IntrusiveSleepAwaiter(timer, duration);
+}
+
+// result of `WithTimeout`, whether a void task finished or the value of a finished task
+template <typename T>
+struct TimeoutResultOf
+{
+    typedef std::optional<T> type;
+};
+
+template <>
+struct TimeoutResultOf<void>
+{
+    typedef bool type;
+};
+
+// races a task against a timer, the task is destroyed at its suspension point on timeout,
+// which cancels timers it is sleeping on.
+template <typename T>
+class TimeoutAwaiter
+{
+public:
+    typedef typename TimeoutResultOf<T>::type Result;
+
+    TimeoutAwaiter(TimerBase& timer, Task<T>&& task, uint32_t duration)
+        : timer_(timer), task_(std::move(task)), duration_(duration)
+    {
+    }
+
+    ~TimeoutAwaiter()
+    {
+        if (pending_) {
+            timer_.Cancel(id_);
+        }
+    }
+
+    TimeoutAwaiter(const TimeoutAwaiter&) = delete;
+    TimeoutAwaiter& operator=(const TimeoutAwaiter&) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h)
+    {
+        awaiting_ = h;
+        id_ = timer_.Start(duration_, Expire{this});
+        pending_ = true;
+        return task_.await_suspend(h); // run the task, it resumes `h` when finished
+    }
+
+    Result await_resume()
+    {
+        if (pending_) {
+            timer_.Cancel(id_); // task finished first
+            pending_ = false;
+        }
+        if (timed_out_) {
+            task_.reset();
+            return Result();
+        }
+        return result();
+    }
+
+private:
+    struct Expire
+    {
+        TimeoutAwaiter* self;
+
+        void operator()() const
+        {
+            self->pending_ = false;
+            self->timed_out_ = true;
+            self->awaiting_.resume();
+        }
+    };
+
+    Result result()
+    {
+        if constexpr (std::is_void<T>::value) {
+            task_.Result();
+            return true;
+        } else {
+            return Result(task_.Result());
+        }
+    }
+
+private:
+    TimerBase& timer_;
+    Task<T> task_;
+    uint32_t duration_ = 0;
+    int id_ = 0;
+    bool pending_ = false;
+    bool timed_out_ = false;
+    std::coroutine_handle<> awaiting_;
+};
+
+// `co_await WithTimeout(timer, task, ms)`, gets `std::optional<T>`, or bool for `Task<void>`,
+// empty(false) if the task did not finish in `ms` milliseconds.
+template <typename T>
+inline TimeoutAwaiter<T> WithTimeout(TimerBase& timer, Task<T> task, uint32_t duration)
+{
+    return TimeoutAwaiter<T>(timer, std::move(task), duration);
+}
+
+#endif // __cpp_impl_coroutine
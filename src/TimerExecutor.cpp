@@ -0,0 +1,156 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "TimerExecutor.h"
+#include "Logging.h"
+
+const int CHUNK_SIZE = 64;  // actions per stealable chunk
+
+TimerExecutor::TimerExecutor(int threads)
+{
+    if (threads < 1) {
+        LOG(FATAL) << "invalid thread count: " << threads;
+    }
+    for (int i = 0; i < threads; i++) {
+        workers_.emplace_back(new Worker);
+    }
+    for (int i = 0; i < threads; i++) {
+        workers_[i]->thread = std::thread(&TimerExecutor::workerLoop, this, i);
+    }
+}
+
+TimerExecutor::~TimerExecutor()
+{
+    {
+        std::lock_guard<std::mutex> guard(idle_mutex_);
+        stop_ = true;
+    }
+    work_cond_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void TimerExecutor::Submit(std::vector<TimeoutAction>& actions)
+{
+    if (actions.empty()) {
+        return;
+    }
+    int n = (int)workers_.size();
+    pending_.fetch_add((int64_t)actions.size(), std::memory_order_relaxed);
+    Chunk chunk;
+    for (auto& action : actions) {
+        const KeyedAction* keyed = action.target<KeyedAction>();
+        if (keyed != nullptr) {
+            Worker& worker = *workers_[keyed->key % n];
+            std::lock_guard<std::mutex> guard(worker.mutex);
+            worker.pinned.push_back(std::move(action));
+            continue;
+        }
+        chunk.push_back(std::move(action));
+        if ((int)chunk.size() == CHUNK_SIZE) {
+            Worker& worker = *workers_[next_worker_++ % n];
+            std::lock_guard<std::mutex> guard(worker.mutex);
+            worker.chunks.push_back(std::move(chunk));
+            chunk.clear();
+        }
+    }
+    if (!chunk.empty()) {
+        Worker& worker = *workers_[next_worker_++ % n];
+        std::lock_guard<std::mutex> guard(worker.mutex);
+        worker.chunks.push_back(std::move(chunk));
+    }
+    actions.clear();
+    {
+        std::lock_guard<std::mutex> guard(idle_mutex_);
+        work_seq_++;
+    }
+    work_cond_.notify_all();
+}
+
+void TimerExecutor::Wait()
+{
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    done_cond_.wait(lock, [this]() {
+        return pending_.load(std::memory_order_acquire) == 0;
+    });
+}
+
+void TimerExecutor::finish(int count)
+{
+    executed_.fetch_add(count, std::memory_order_relaxed);
+    if (pending_.fetch_sub(count, std::memory_order_acq_rel) == count) {
+        std::lock_guard<std::mutex> guard(idle_mutex_);
+        done_cond_.notify_all();
+    }
+}
+
+// run one keyed action of this worker
+bool TimerExecutor::runPinned(Worker& worker)
+{
+    TimeoutAction action;
+    {
+        std::lock_guard<std::mutex> guard(worker.mutex);
+        if (worker.pinned.empty()) {
+            return false;
+        }
+        action = std::move(worker.pinned.front());
+        worker.pinned.pop_front();
+    }
+    action();
+    finish(1);
+    return true;
+}
+
+// run a chunk from front of own deque, or back of a victim's deque
+bool TimerExecutor::runChunk(Worker& worker, bool steal)
+{
+    Chunk chunk;
+    {
+        std::lock_guard<std::mutex> guard(worker.mutex);
+        if (worker.chunks.empty()) {
+            return false;
+        }
+        if (steal) {
+            chunk = std::move(worker.chunks.back());
+            worker.chunks.pop_back();
+        } else {
+            chunk = std::move(worker.chunks.front());
+            worker.chunks.pop_front();
+        }
+    }
+    for (auto& action : chunk) {
+        if (action) {
+            action();
+        }
+    }
+    finish((int)chunk.size());
+    return true;
+}
+
+void TimerExecutor::workerLoop(int index)
+{
+    int n = (int)workers_.size();
+    Worker& self = *workers_[index];
+    for (;;) {
+        int64_t seen = 0;
+        {
+            std::lock_guard<std::mutex> guard(idle_mutex_);
+            seen = work_seq_;
+        }
+        bool found = runPinned(self) || runChunk(self, false);
+        for (int i = 1; i < n && !found; i++) {
+            found = runChunk(*workers_[(index + i) % n], true);
+        }
+        if (found) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        if (stop_ && pending_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+        work_cond_.wait(lock, [&]() {
+            return stop_ || work_seq_ != seen;
+        });
+    }
+}
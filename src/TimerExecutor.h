@@ -0,0 +1,94 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// an expiry action with an ordering key,
+// actions of the same key are run serially in submitting order by `TimerExecutor`.
+struct KeyedAction
+{
+    uint64_t key = 0;
+    TimeoutAction action = nullptr;
+
+    KeyedAction(uint64_t k, TimeoutAction a)
+        : key(k), action(std::move(a))
+    {
+    }
+
+    void operator()() const
+    {
+        if (action) {
+            action();
+        }
+    }
+};
+
+// work-stealing thread pool running fired timer callbacks off the scheduler thread.
+//
+// a submitted batch is cut into chunks spread over workers' deques, a worker takes
+// chunks from the front of its own deque and steals from the back of others when idle.
+// a `KeyedAction` is pinned to the worker picked by its key and never stolen,
+// so actions of one key keep their order.
+//
+// callbacks run concurrently with the scheduler, they must not touch it.
+class TimerExecutor
+{
+public:
+    explicit TimerExecutor(int threads);
+    ~TimerExecutor();
+
+    TimerExecutor(const TimerExecutor&) = delete;
+    TimerExecutor& operator=(const TimerExecutor&) = delete;
+
+    // hand over a batch of actions, `actions` is left empty
+    void Submit(std::vector<TimeoutAction>& actions);
+
+    // block until all submitted actions have run
+    void Wait();
+
+    int ThreadCount() const
+    {
+        return (int)workers_.size();
+    }
+
+    // count of actions run
+    int64_t Executed() const
+    {
+        return executed_.load(std::memory_order_relaxed);
+    }
+
+private:
+    typedef std::vector<TimeoutAction> Chunk;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;           // stealable
+        std::deque<TimeoutAction> pinned;   // keyed actions, run in order
+        std::thread thread;
+    };
+
+    bool runPinned(Worker& worker);
+    bool runChunk(Worker& worker, bool steal);
+    void finish(int count);
+    void workerLoop(int index);
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex idle_mutex_;
+    std::condition_variable work_cond_;     // new work or stop
+    std::condition_variable done_cond_;     // all work done
+    int64_t work_seq_ = 0;                  // bumped by each submit, under `idle_mutex_`
+    bool stop_ = false;
+    int next_worker_ = 0;
+    std::atomic<int64_t> pending_{0};
+    std::atomic<int64_t> executed_{0};
+};
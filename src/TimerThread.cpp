@@ -0,0 +1,178 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "TimerThread.h"
+#include "Clock.h"
+#include <chrono>
+
+using namespace std::chrono;
+
+static int64_t nowNanos()
+{
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// records lateness of a fired timer then runs its action, on ticker thread
+struct LatenessRecorder
+{
+    TimerThread* owner;
+    int64_t deadline;
+    TimeoutAction action;
+
+    void operator()() const
+    {
+        owner->record(deadline);
+        if (action) {
+            action();
+        }
+    }
+};
+
+TimerThread::TimerThread(std::shared_ptr<TimerBase> timer, TickMode mode, int spin_us)
+    : timer_(timer), mode_(mode), spin_us_(spin_us)
+{
+}
+
+TimerThread::~TimerThread()
+{
+    Stop();
+}
+
+void TimerThread::Run()
+{
+    if (thread_.joinable()) {
+        return;
+    }
+    stop_ = false;
+    std::lock_guard<std::mutex> guard(mutex_);
+    thread_ = std::thread(&TimerThread::tickLoop, this);
+    ticker_id_.store(thread_.get_id()); // before the ticker takes `mutex_`
+}
+
+void TimerThread::Stop()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+    wake_cond_.notify_one();
+    thread_.join();
+    ticker_id_.store(std::thread::id());
+}
+
+int TimerThread::Start(uint32_t duration, TimeoutAction action)
+{
+    // the scheduler starts at the same deadline lateness is measured from
+    int64_t deadline = Clock::CurrentTimeMillis() + (int64_t)duration;
+    TimeoutAction recorder = LatenessRecorder{this, deadline, std::move(action)};
+    if (isTicker()) {
+        return timer_->startAt(deadline, std::move(recorder)); // ticker recomputes its wait
+    }
+    std::lock_guard<std::mutex> guard(mutex_);
+    int id = timer_->startAt(deadline, std::move(recorder));
+    if (deadline < wake_at_.load(std::memory_order_relaxed)) {
+        wake_at_.store(deadline, std::memory_order_relaxed);
+        wake_cond_.notify_one();
+    }
+    return id;
+}
+
+bool TimerThread::Cancel(int timer_id)
+{
+    if (isTicker()) {
+        return timer_->Cancel(timer_id);
+    }
+    std::lock_guard<std::mutex> guard(mutex_);
+    return timer_->Cancel(timer_id);
+}
+
+int TimerThread::Size() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return timer_->Size();
+}
+
+TimerThreadStats TimerThread::Stats() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return stats_;
+}
+
+// under `mutex_`
+void TimerThread::record(int64_t deadline)
+{
+    int64_t late_us = (nowNanos() - deadline * 1000000) / 1000;
+    int bucket = 0;
+    while (bucket < LATENESS_BUCKETS - 1 && late_us >= (1LL << bucket)) {
+        bucket++;
+    }
+    stats_.lateness[bucket]++;
+    stats_.fired++;
+}
+
+// under `mutex_`, INT64_MAX if no pending timer
+int64_t TimerThread::nextWake() const
+{
+    int64_t deadline = timer_->NextDeadline();
+    if (deadline >= 0) {
+        return deadline;
+    }
+    if (timer_->Size() == 0) {
+        return INT64_MAX;
+    }
+    return Clock::CurrentTimeMillis() + 1; // not tracked, tick every 1ms
+}
+
+// block until `until_ns`, or a timer earlier than `deadline` is started
+void TimerThread::waitUntil(std::unique_lock<std::mutex>& lock, int64_t deadline, int64_t until_ns)
+{
+    if (deadline == INT64_MAX) {
+        wake_cond_.wait(lock, [this]() {
+            return stop_ || wake_at_.load(std::memory_order_relaxed) != INT64_MAX;
+        });
+        return;
+    }
+    system_clock::time_point until{duration_cast<system_clock::duration>(nanoseconds(until_ns))};
+    wake_cond_.wait_until(lock, until, [this, deadline, until_ns]() {
+        return stop_ || wake_at_.load(std::memory_order_relaxed) < deadline || nowNanos() >= until_ns;
+    });
+}
+
+// spin unlocked until the millisecond of `wake_at_` begins
+void TimerThread::spinUntil(int64_t deadline)
+{
+    while (!stop_.load(std::memory_order_relaxed) && Clock::CurrentTimeMillis() < deadline) {
+        int64_t wake_at = wake_at_.load(std::memory_order_relaxed);
+        if (wake_at < deadline) {
+            deadline = wake_at; // an earlier timer started
+        }
+    }
+}
+
+void TimerThread::tickLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        timer_->Update(Clock::CurrentTimeMillis());
+        int64_t deadline = nextWake();
+        wake_at_.store(deadline, std::memory_order_relaxed);
+        if (mode_ == TickMode::BusyPoll) {
+            lock.unlock();
+            spinUntil(deadline);
+            lock.lock();
+        } else if (mode_ == TickMode::Hybrid && deadline != INT64_MAX) {
+            waitUntil(lock, deadline, deadline * 1000000 - (int64_t)spin_us_ * 1000);
+            if (!stop_ && wake_at_.load(std::memory_order_relaxed) >= deadline) {
+                lock.unlock();
+                spinUntil(deadline);
+                lock.lock();
+            }
+        } else {
+            waitUntil(lock, deadline, deadline == INT64_MAX ? INT64_MAX : deadline * 1000000);
+        }
+        stats_.wakeups++;
+    }
+}
@@ -0,0 +1,90 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "TimerBase.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// how the ticker thread waits for next deadline
+enum class TickMode
+{
+    Sleep,      // block on a condition variable until next deadline
+    Hybrid,     // block until shortly before next deadline, then spin
+    BusyPoll,   // spin all the time, for a dedicated core
+};
+
+const int LATENESS_BUCKETS = 16;
+
+// counters of a ticker thread
+struct TimerThreadStats
+{
+    int64_t fired = 0;
+    int64_t wakeups = 0;    // count of waits ended, by deadline or by an earlier timer
+
+    // fired timers by lateness to their millisecond deadline,
+    // bucket 0 is below 1us, bucket i is [2^(i-1), 2^i) us, the last is anything later.
+    int64_t lateness[LATENESS_BUCKETS] = {};
+};
+
+// a dedicated ticker thread driving any scheduler, like the worker thread of Netty's HashedWheelTimer.
+//
+// the ticker waits until `NextDeadline()` of the scheduler, every 1ms if the scheduler
+// does not track it, and is woken early when an earlier timer is started.
+// `Start` and `Cancel` may be called from any thread, callbacks run on the ticker thread
+// under the scheduler lock, so a callback may start or cancel timers directly.
+class TimerThread
+{
+public:
+    // `spin_us` is the time spun before each deadline in hybrid mode
+    explicit TimerThread(std::shared_ptr<TimerBase> timer, TickMode mode = TickMode::Sleep, int spin_us = 200);
+    ~TimerThread();
+
+    TimerThread(const TimerThread&) = delete;
+    TimerThread& operator=(const TimerThread&) = delete;
+
+    // start the ticker thread
+    void Run();
+
+    // stop and join the ticker thread, pending timers are kept
+    void Stop();
+
+    // start a timer after `duration` milliseconds, from any thread
+    int Start(uint32_t duration, TimeoutAction action);
+
+    // cancel a timer from any thread
+    bool Cancel(int timer_id);
+
+    int Size() const;
+
+    TimerThreadStats Stats() const;
+
+private:
+    bool isTicker() const
+    {
+        return std::this_thread::get_id() == ticker_id_.load(std::memory_order_relaxed);
+    }
+
+    int64_t nextWake() const;
+    void record(int64_t deadline);
+    void waitUntil(std::unique_lock<std::mutex>& lock, int64_t deadline, int64_t until_ns);
+    void spinUntil(int64_t deadline);
+    void tickLoop();
+
+    friend struct LatenessRecorder;
+
+private:
+    std::shared_ptr<TimerBase> timer_;
+    TickMode mode_ = TickMode::Sleep;
+    int spin_us_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_cond_;
+    std::atomic<int64_t> wake_at_{INT64_MAX};   // deadline the ticker waits for
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+    std::atomic<std::thread::id> ticker_id_;    // read by `Start` and `Cancel` of any thread
+    TimerThreadStats stats_;                    // under `mutex_`
+};
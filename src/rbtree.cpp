@@ -0,0 +1,249 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#include "rbtree.h"
+
+// red-black tree algorithms, see Introduction to Algorithms, chapter 13
+
+static inline int rb_is_red(const struct rb_node* node)
+{
+    return node != NULL && node->rb_color == RB_RED;
+}
+
+static inline int rb_is_black(const struct rb_node* node)
+{
+    return node == NULL || node->rb_color == RB_BLACK;
+}
+
+static inline void rb_change_child(struct rb_node* old, struct rb_node* new_,
+    struct rb_node* parent, struct rb_root* root)
+{
+    if (parent == NULL) {
+        root->node = new_;
+    }
+    else if (parent->rb_left == old) {
+        parent->rb_left = new_;
+    }
+    else {
+        parent->rb_right = new_;
+    }
+}
+
+static void rb_rotate_left(struct rb_node* node, struct rb_root* root)
+{
+    struct rb_node* right = node->rb_right;
+    struct rb_node* parent = node->rb_parent;
+
+    node->rb_right = right->rb_left;
+    if (right->rb_left != NULL) {
+        right->rb_left->rb_parent = node;
+    }
+    right->rb_left = node;
+    right->rb_parent = parent;
+    rb_change_child(node, right, parent, root);
+    node->rb_parent = right;
+}
+
+static void rb_rotate_right(struct rb_node* node, struct rb_root* root)
+{
+    struct rb_node* left = node->rb_left;
+    struct rb_node* parent = node->rb_parent;
+
+    node->rb_left = left->rb_right;
+    if (left->rb_right != NULL) {
+        left->rb_right->rb_parent = node;
+    }
+    left->rb_right = node;
+    left->rb_parent = parent;
+    rb_change_child(node, left, parent, root);
+    node->rb_parent = left;
+}
+
+void rb_insert_color(struct rb_node* node, struct rb_root* root)
+{
+    struct rb_node* parent;
+    while ((parent = node->rb_parent) != NULL && parent->rb_color == RB_RED) {
+        struct rb_node* gparent = parent->rb_parent;
+        if (parent == gparent->rb_left) {
+            struct rb_node* uncle = gparent->rb_right;
+            if (rb_is_red(uncle)) {
+                uncle->rb_color = RB_BLACK;
+                parent->rb_color = RB_BLACK;
+                gparent->rb_color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_right) {
+                rb_rotate_left(parent, root);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = RB_BLACK;
+            gparent->rb_color = RB_RED;
+            rb_rotate_right(gparent, root);
+        }
+        else {
+            struct rb_node* uncle = gparent->rb_left;
+            if (rb_is_red(uncle)) {
+                uncle->rb_color = RB_BLACK;
+                parent->rb_color = RB_BLACK;
+                gparent->rb_color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_left) {
+                rb_rotate_right(parent, root);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = RB_BLACK;
+            gparent->rb_color = RB_RED;
+            rb_rotate_left(gparent, root);
+        }
+    }
+    root->node->rb_color = RB_BLACK;
+}
+
+// restore black height after a black node was removed,
+// `node` may be NULL so its parent is passed explicitly.
+static void rb_erase_color(struct rb_node* node, struct rb_node* parent, struct rb_root* root)
+{
+    while (node != root->node && rb_is_black(node)) {
+        if (node == parent->rb_left) {
+            struct rb_node* sibling = parent->rb_right;
+            if (rb_is_red(sibling)) {
+                sibling->rb_color = RB_BLACK;
+                parent->rb_color = RB_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->rb_right;
+            }
+            if (rb_is_black(sibling->rb_left) && rb_is_black(sibling->rb_right)) {
+                sibling->rb_color = RB_RED;
+                node = parent;
+                parent = node->rb_parent;
+                continue;
+            }
+            if (rb_is_black(sibling->rb_right)) {
+                sibling->rb_left->rb_color = RB_BLACK;
+                sibling->rb_color = RB_RED;
+                rb_rotate_right(sibling, root);
+                sibling = parent->rb_right;
+            }
+            sibling->rb_color = parent->rb_color;
+            parent->rb_color = RB_BLACK;
+            sibling->rb_right->rb_color = RB_BLACK;
+            rb_rotate_left(parent, root);
+            node = root->node;
+            break;
+        }
+        else {
+            struct rb_node* sibling = parent->rb_left;
+            if (rb_is_red(sibling)) {
+                sibling->rb_color = RB_BLACK;
+                parent->rb_color = RB_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->rb_left;
+            }
+            if (rb_is_black(sibling->rb_left) && rb_is_black(sibling->rb_right)) {
+                sibling->rb_color = RB_RED;
+                node = parent;
+                parent = node->rb_parent;
+                continue;
+            }
+            if (rb_is_black(sibling->rb_left)) {
+                sibling->rb_right->rb_color = RB_BLACK;
+                sibling->rb_color = RB_RED;
+                rb_rotate_left(sibling, root);
+                sibling = parent->rb_left;
+            }
+            sibling->rb_color = parent->rb_color;
+            parent->rb_color = RB_BLACK;
+            sibling->rb_left->rb_color = RB_BLACK;
+            rb_rotate_right(parent, root);
+            node = root->node;
+            break;
+        }
+    }
+    if (node != NULL) {
+        node->rb_color = RB_BLACK;
+    }
+}
+
+void rb_erase(struct rb_node* node, struct rb_root* root)
+{
+    struct rb_node* child;
+    struct rb_node* parent;
+    int color;
+
+    if (node->rb_left == NULL || node->rb_right == NULL) {
+        child = node->rb_left != NULL ? node->rb_left : node->rb_right;
+        parent = node->rb_parent;
+        color = node->rb_color;
+        if (child != NULL) {
+            child->rb_parent = parent;
+        }
+        rb_change_child(node, child, parent, root);
+    }
+    else {
+        // replace `node` by its in-order successor
+        struct rb_node* successor = node->rb_right;
+        while (successor->rb_left != NULL) {
+            successor = successor->rb_left;
+        }
+        child = successor->rb_right;
+        color = successor->rb_color;
+        if (successor->rb_parent == node) {
+            parent = successor;
+        }
+        else {
+            parent = successor->rb_parent;
+            parent->rb_left = child;
+            if (child != NULL) {
+                child->rb_parent = parent;
+            }
+            successor->rb_right = node->rb_right;
+            node->rb_right->rb_parent = successor;
+        }
+        successor->rb_left = node->rb_left;
+        node->rb_left->rb_parent = successor;
+        successor->rb_parent = node->rb_parent;
+        successor->rb_color = node->rb_color;
+        rb_change_child(node, successor, node->rb_parent, root);
+    }
+
+    if (color == RB_BLACK) {
+        rb_erase_color(child, parent, root);
+    }
+
+    // reset to unlinked state
+    node->rb_parent = node->rb_left = node->rb_right = NULL;
+    node->rb_color = RB_RED;
+}
+
+struct rb_node* rb_first(const struct rb_root* root)
+{
+    struct rb_node* n = root->node;
+    if (n == NULL) {
+        return NULL;
+    }
+    while (n->rb_left != NULL) {
+        n = n->rb_left;
+    }
+    return n;
+}
+
+struct rb_node* rb_next(const struct rb_node* node)
+{
+    if (node->rb_right != NULL) {
+        node = node->rb_right;
+        while (node->rb_left != NULL) {
+            node = node->rb_left;
+        }
+        return const_cast<struct rb_node*>(node);
+    }
+    struct rb_node* parent;
+    while ((parent = node->rb_parent) != NULL && node == parent->rb_right) {
+        node = parent;
+    }
+    return parent;
+}
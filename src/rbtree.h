@@ -0,0 +1,82 @@
+// Copyright © 2023 ichenq@gmail.com All rights reserved.
+// See accompanying files LICENSE
+
+#pragma once
+
+#include "list_impl.h"
+
+/*
+ * Intrusive red-black tree, modeled after linux/include/linux/rbtree.h
+ *
+ * The tree never allocates, users embed a `struct rb_node` in their own
+ * structure and do the search-and-link themselves, then call rb_insert_color()
+ * to re-balance the tree:
+ *
+ *     struct rb_node** link = &root->node;
+ *     struct rb_node* parent = NULL;
+ *     while (*link) {
+ *         parent = *link;
+ *         if (less(node, parent))
+ *             link = &parent->rb_left;
+ *         else
+ *             link = &parent->rb_right;
+ *     }
+ *     rb_link_node(node, parent, link);
+ *     rb_insert_color(node, root);
+ */
+
+#define RB_RED      0
+#define RB_BLACK    1
+
+struct rb_node {
+    rb_node* rb_parent = NULL;
+    rb_node* rb_left = NULL;
+    rb_node* rb_right = NULL;
+    int rb_color = RB_RED;
+};
+
+struct rb_root {
+    rb_node* node = NULL;
+};
+
+/**
+ * rb_entry - get the struct for this entry
+ * @ptr:	the &struct rb_node pointer.
+ * @type:	the type of the struct this is embedded in.
+ * @member:	the name of the rb_node within the struct.
+ */
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define RB_EMPTY_ROOT(root)  ((root)->node == NULL)
+
+// is a node linked in any tree ?
+inline int rb_linked(const struct rb_node* node)
+{
+    return node->rb_parent != NULL || node->rb_left != NULL ||
+        node->rb_right != NULL || node->rb_color == RB_BLACK;
+}
+
+inline void rb_link_node(struct rb_node* node, struct rb_node* parent, struct rb_node** rb_link)
+{
+    node->rb_parent = parent;
+    node->rb_color = RB_RED;
+    node->rb_left = node->rb_right = NULL;
+    *rb_link = node;
+}
+
+/*
+ * rb_insert_color - re-balance the tree after rb_link_node()
+ */
+void rb_insert_color(struct rb_node* node, struct rb_root* root);
+
+/*
+ * rb_erase - unlink `node` from the tree, O(log N) re-balance without any search.
+ * the node is reset to the unlinked state.
+ */
+void rb_erase(struct rb_node* node, struct rb_root* root);
+
+/*
+ * rb_first/rb_next - in-order traversal
+ */
+struct rb_node* rb_first(const struct rb_root* root);
+struct rb_node* rb_next(const struct rb_node* node);
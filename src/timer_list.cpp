@@ -171,11 +171,11 @@ static int cascade(struct tvec_base* base, struct tvec* tv, int index)
 
     while (&timer->entry != &tv_list)
     {
-        timer = tmp;
-        tmp = list_entry(tmp->entry.next, timer_list, entry);
         // BUG_ON(tbase_get_base(timer->base) != base);
         /* No accounting, while moving them */
         __internal_add_timer(base, timer);
+        timer = tmp;
+        tmp = list_entry(tmp->entry.next, timer_list, entry);
     }
 
     return index;
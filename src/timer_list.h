@@ -50,6 +50,7 @@ struct timer_list {
     struct list_head entry;
     int id = 0;
     int64_t expires = 0;
+    uint64_t cookie = 0;
     tvec_base* base = NULL;
     void (*function)(timer_list*) = NULL;
     void* data;
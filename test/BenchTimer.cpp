@@ -4,10 +4,35 @@
 
 #include <algorithm>
 #include "TimerBase.h"
+#include "IntrusiveRBTreeTimer.h"
+#include "DAryHeapTimer.h"
+#include "CoalescedHeapTimer.h"
+#include "DurationQueueTimer.h"
+#include "HybridWheelTimer.h"
+#include "AdaptiveTimer.h"
+#include "BufferedHeapTimer.h"
+#include "PrecisionTimer.h"
+#include "CommandQueueTimer.h"
+#include "ConcurrentHashedWheelTimer.h"
+#include "StripedTimer.h"
+#include "GoTimerHeap.h"
+#include "DelayQueue.h"
+#include "TimerExecutor.h"
+#include "TimerThread.h"
+#include "EventLoop.h"
+#include "TimerCoroutine.h"
+#include "HashedWheelTimer.h"
+#include "ShardedTimerService.h"
+#include "QuadHeapTimer.h"
+#include "PriorityQueueTimer.h"
+#include "RBTreeTimer.h"
 #include "Clock.h"
 #include "Preprocessor.h"
 #include <benchmark/benchmark.h>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
@@ -67,16 +92,22 @@ static void BM_HHWheelTimerAdd(benchmark::State& state)
     doNotOptimizeAway(timer);
 }
 
+static void BM_IntrusiveRBTreeTimerAdd(benchmark::State& state)
+{
+    auto timer = createAndStartTimer(TimerSchedType::TIMER_INTRUSIVE_RBTREE, state);
+    doNotOptimizeAway(timer);
+}
+
 BENCHMARK(BM_PQTimerAdd);
 BENCHMARK(BM_QuadHeapTimerAdd);
 BENCHMARK(BM_RBTreeTimerAdd);
 BENCHMARK(BM_HashWheelTimerAdd);
 BENCHMARK(BM_HHWheelTimerAdd);
+BENCHMARK(BM_IntrusiveRBTreeTimerAdd);
 
 
-static std::shared_ptr<TimerBase> createAndFillTimer(TimerSchedType timerType, int N, vector<int>& out) {
+static void fillTimer(TimerBase* timer, int N, vector<int>& out) {
     uint32_t seed = lcg_seed(12345);
-    auto timer = CreateTimer(timerType);
     auto dummy = []() {};
     for (int i = 0; i < N; i++)
     {
@@ -85,15 +116,20 @@ static std::shared_ptr<TimerBase> createAndFillTimer(TimerSchedType timerType, i
         out.push_back(tid);
     }
     std::random_shuffle(out.begin(), out.end());
+}
+
+static std::shared_ptr<TimerBase> createAndFillTimer(TimerSchedType timerType, int N, vector<int>& out) {
+    auto timer = CreateTimer(timerType);
+    fillTimer(timer.get(), N, out);
     return timer;
 }
 
-static void benchTimerCancel(TimerSchedType timerType, benchmark::State& state)
+static void benchTimerCancel(std::shared_ptr<TimerBase> timer, benchmark::State& state)
 {
     int N = (int)state.max_iterations;
     vector<int> timer_ids;
     timer_ids.reserve(N);
-    auto timer = createAndFillTimer(timerType, N, timer_ids);
+    fillTimer(timer.get(), N, timer_ids);
     for (auto _ : state)
     {
         if (timer_ids.empty()) {
@@ -106,6 +142,11 @@ static void benchTimerCancel(TimerSchedType timerType, benchmark::State& state)
     doNotOptimizeAway(timer);
 }
 
+static void benchTimerCancel(TimerSchedType timerType, benchmark::State& state)
+{
+    benchTimerCancel(CreateTimer(timerType), state);
+}
+
 static void BM_PQTimerCancel(benchmark::State& state) {
 
     benchTimerCancel(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
@@ -131,12 +172,55 @@ static void BM_HHWheelTimerCancel(benchmark::State& state) {
     benchTimerCancel(TimerSchedType::TIMER_HH_WHEEL, state);
 }
 
+static void BM_IntrusiveRBTreeTimerCancel(benchmark::State& state) {
+
+    benchTimerCancel(TimerSchedType::TIMER_INTRUSIVE_RBTREE, state);
+}
+
+static void BM_PQTimerLazyCancel(benchmark::State& state) {
+    benchTimerCancel(std::make_shared<PriorityQueueTimer>(true), state);
+}
+
+static void BM_RBTreeTimerLazyCancel(benchmark::State& state) {
+    benchTimerCancel(std::make_shared<RBTreeTimer>(true), state);
+}
+
+// cancel caller-owned entries by handle, no id lookup
+static void BM_IntrusiveRBTreeTimerUnschedule(benchmark::State& state) {
+    int N = (int)state.max_iterations;
+    uint32_t seed = lcg_seed(12345);
+    IntrusiveRBTreeTimer timer;
+    vector<RBTimerEntry> entries(N);
+    vector<RBTimerEntry*> handles;
+    handles.reserve(N);
+    for (int i = 0; i < N; i++)
+    {
+        uint32_t duration = lcg_rand(seed) % 5000;
+        timer.Schedule(&entries[i], duration);
+        handles.push_back(&entries[i]);
+    }
+    std::random_shuffle(handles.begin(), handles.end());
+    for (auto _ : state)
+    {
+        if (handles.empty()) {
+            break;
+        }
+        timer.Unschedule(handles.back());
+        handles.pop_back();
+    }
+    doNotOptimizeAway(timer);
+}
+
 
 BENCHMARK(BM_PQTimerCancel);
 BENCHMARK(BM_QuadHeapTimerCancel); // lazy deletion here not fair
 BENCHMARK(BM_RBTreeTimerCancel);
 BENCHMARK(BM_HashWheelTimerCancel);
 BENCHMARK(BM_HHWheelTimerCancel);
+BENCHMARK(BM_IntrusiveRBTreeTimerCancel);
+BENCHMARK(BM_IntrusiveRBTreeTimerUnschedule);
+BENCHMARK(BM_PQTimerLazyCancel);
+BENCHMARK(BM_RBTreeTimerLazyCancel);
 
 
 static void benchTimerTick(TimerSchedType timerType, benchmark::State& state)
@@ -176,10 +260,1554 @@ static void BM_HHWheelTimerTick(benchmark::State& state) {
     benchTimerTick(TimerSchedType::TIMER_HH_WHEEL, state);
 }
 
+static void BM_IntrusiveRBTreeTimerTick(benchmark::State& state) {
+
+    benchTimerTick(TimerSchedType::TIMER_INTRUSIVE_RBTREE, state);
+}
+
 
 BENCHMARK(BM_PQTimerTick);
 BENCHMARK(BM_QuadHeapTimerTick);
 BENCHMARK(BM_RBTreeTimerTick);
 BENCHMARK(BM_HashWheelTimerTick);
 BENCHMARK(BM_HHWheelTimerTick);
+BENCHMARK(BM_IntrusiveRBTreeTimerTick);
+
+
+
+template <int D>
+static void BM_DAryHeapTimerAdd(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    DAryHeapTimer<D> timer;
+    auto dummy = []() {};
+    for (auto _ : state)
+    {
+        uint32_t duration = lcg_rand(seed) % 5000;
+        timer.Start(duration, dummy);
+    }
+    doNotOptimizeAway(timer);
+}
+
+template <int D>
+static void BM_DAryHeapTimerCancel(benchmark::State& state)
+{
+    int N = (int)state.max_iterations;
+    uint32_t seed = lcg_seed(12345);
+    DAryHeapTimer<D> timer;
+    auto dummy = []() {};
+    vector<int> timer_ids;
+    timer_ids.reserve(N);
+    for (int i = 0; i < N; i++)
+    {
+        uint32_t duration = lcg_rand(seed) % 5000;
+        timer_ids.push_back(timer.Start(duration, dummy));
+    }
+    std::random_shuffle(timer_ids.begin(), timer_ids.end());
+    for (auto _ : state)
+    {
+        if (timer_ids.empty()) {
+            break;
+        }
+        timer.Cancel(timer_ids.back());
+        timer_ids.pop_back();
+    }
+    doNotOptimizeAway(timer);
+}
+
+// operation mix over a steady-state heap of N timers.
+// each iteration either cancels a random timer(with `cancel%` chance) or
+// expires the earliest ones, then starts new timers to keep N pending.
+template <int D>
+static void BM_DAryHeapTimerMix(benchmark::State& state)
+{
+    const int N = (int)state.range(0);
+    const int cancel_percent = (int)state.range(1);
+    uint32_t seed = lcg_seed(12345);
+    DAryHeapTimer<D> timer;
+    vector<int> timer_ids(N);
+    vector<int> free_slots;
+    for (int i = 0; i < N; i++)
+    {
+        free_slots.push_back(i);
+    }
+    auto refill = [&]() {
+        for (int k : free_slots)
+        {
+            uint32_t duration = lcg_rand(seed) % 5000;
+            timer_ids[k] = timer.Start(duration, [&free_slots, k]() {
+                free_slots.push_back(k);
+            });
+        }
+        free_slots.clear();
+    };
+    refill();
+    for (auto _ : state)
+    {
+        if ((int)(lcg_rand(seed) % 100) < cancel_percent) {
+            int k = (int)(((lcg_rand(seed) << 15) | lcg_rand(seed)) % N);
+            timer.Cancel(timer_ids[k]);
+            free_slots.push_back(k);
+        } else {
+            timer.Update(timer.NextDeadline());
+        }
+        refill();
+    }
+    doNotOptimizeAway(timer);
+}
+
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerAdd, 2);
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerAdd, 4);
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerAdd, 8);
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerAdd, 16);
+
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerCancel, 2);
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerCancel, 4);
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerCancel, 8);
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerCancel, 16);
+
+#define DARY_HEAP_MIX_ARGS \
+    ArgsProduct({ {1 << 10, 1 << 14, 1 << 17}, {0, 50, 90} })->ArgNames({"N", "cancel%"})
+
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerMix, 2)->DARY_HEAP_MIX_ARGS;
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerMix, 4)->DARY_HEAP_MIX_ARGS;
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerMix, 8)->DARY_HEAP_MIX_ARGS;
+BENCHMARK_TEMPLATE(BM_DAryHeapTimerMix, 16)->DARY_HEAP_MIX_ARGS;
+
+
+// realistic clustered timeouts, most timers use one of a few durations
+static const uint32_t ClusteredDurations[] = { 100, 500, 1000, 5000, 30000 };
+
+static std::shared_ptr<TimerBase> createClusteredTimer(TimerSchedType timerType, int N)
+{
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    auto dummy = []() {};
+    for (int i = 0; i < N; i++)
+    {
+        uint32_t duration = ClusteredDurations[lcg_rand(seed) % 5];
+        timer->Start(duration, dummy);
+    }
+    return timer;
+}
+
+static void benchClusteredAdd(TimerSchedType timerType, benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    auto dummy = []() {};
+    for (auto _ : state)
+    {
+        uint32_t duration = ClusteredDurations[lcg_rand(seed) % 5];
+        timer->Start(duration, dummy);
+    }
+    auto coalesced = dynamic_cast<CoalescedHeapTimer*>(timer.get());
+    if (coalesced != nullptr) {
+        state.counters["buckets"] = coalesced->BucketCount();
+    }
+    doNotOptimizeAway(timer);
+}
+
+// expire MaxN clustered timers in one Update
+static void benchClusteredExpire(TimerSchedType timerType, benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto timer = createClusteredTimer(timerType, MaxN);
+        int64_t now = Clock::CurrentTimeMillis() + 60000;
+        state.ResumeTiming();
+
+        int fired = timer->Update(now);
+
+        state.PauseTiming();
+        doNotOptimizeAway(fired);
+        timer.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * MaxN);
+}
+
+static void BM_PQTimerClusteredAdd(benchmark::State& state) {
+    benchClusteredAdd(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
+}
+
+static void BM_QuadHeapTimerClusteredAdd(benchmark::State& state) {
+    benchClusteredAdd(TimerSchedType::TIMER_QUAD_HEAP, state);
+}
+
+static void BM_DAryHeapTimerClusteredAdd(benchmark::State& state) {
+    benchClusteredAdd(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_CoalescedHeapTimerClusteredAdd(benchmark::State& state) {
+    benchClusteredAdd(TimerSchedType::TIMER_COALESCED_HEAP, state);
+}
+
+static void BM_PQTimerClusteredExpire(benchmark::State& state) {
+    benchClusteredExpire(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
+}
+
+static void BM_QuadHeapTimerClusteredExpire(benchmark::State& state) {
+    benchClusteredExpire(TimerSchedType::TIMER_QUAD_HEAP, state);
+}
+
+static void BM_DAryHeapTimerClusteredExpire(benchmark::State& state) {
+    benchClusteredExpire(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_CoalescedHeapTimerClusteredExpire(benchmark::State& state) {
+    benchClusteredExpire(TimerSchedType::TIMER_COALESCED_HEAP, state);
+}
+
+BENCHMARK(BM_PQTimerClusteredAdd);
+BENCHMARK(BM_QuadHeapTimerClusteredAdd);
+BENCHMARK(BM_DAryHeapTimerClusteredAdd);
+BENCHMARK(BM_CoalescedHeapTimerClusteredAdd);
+
+BENCHMARK(BM_PQTimerClusteredExpire)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QuadHeapTimerClusteredExpire)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DAryHeapTimerClusteredExpire)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CoalescedHeapTimerClusteredExpire)->Unit(benchmark::kMillisecond);
+
+// keepalive workload: every connection has a constant idle timeout,
+// each packet cancels the connection's timer and starts it again.
+static void benchKeepalive(TimerSchedType timerType, benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    auto dummy = []() {};
+    std::vector<int> conns(MaxN);
+    for (int i = 0; i < MaxN; i++)
+    {
+        // 1 of 8 connections use heartbeat timeout
+        uint32_t duration = (i % 8 == 0) ? 5000 : 60000;
+        conns[i] = timer->Start(duration, dummy);
+    }
+    for (auto _ : state)
+    {
+        int i = lcg_rand(seed) % MaxN;
+        uint32_t duration = (i % 8 == 0) ? 5000 : 60000;
+        timer->Cancel(conns[i]);
+        conns[i] = timer->Start(duration, dummy);
+    }
+    state.SetItemsProcessed(state.iterations());
+    doNotOptimizeAway(timer);
+}
+
+static void BM_QuadHeapTimerKeepalive(benchmark::State& state) {
+    benchKeepalive(TimerSchedType::TIMER_QUAD_HEAP, state);
+}
+
+static void BM_HashedWheelTimerKeepalive(benchmark::State& state) {
+    benchKeepalive(TimerSchedType::TIMER_HASHED_WHEEL, state);
+}
+
+static void BM_DAryHeapTimerKeepalive(benchmark::State& state) {
+    benchKeepalive(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_DurationQueueTimerKeepalive(benchmark::State& state) {
+    benchKeepalive(TimerSchedType::TIMER_DURATION_QUEUE, state);
+}
+
+BENCHMARK(BM_QuadHeapTimerKeepalive);
+BENCHMARK(BM_HashedWheelTimerKeepalive);
+BENCHMARK(BM_DAryHeapTimerKeepalive);
+BENCHMARK(BM_DurationQueueTimerKeepalive);
+
+// mixed-horizon workload: most timers are short, some are minutes long.
+static uint32_t mixedHorizonDuration(uint32_t& seed)
+{
+    if (lcg_rand(seed) % 100 < 80) {
+        return lcg_rand(seed) % 5000;
+    }
+    return 60000 + ((lcg_rand(seed) << 15) | lcg_rand(seed)) % 600000;
+}
+
+static void benchMixedHorizonAdd(TimerSchedType timerType, benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    auto dummy = []() {};
+    for (auto _ : state)
+    {
+        timer->Start(mixedHorizonDuration(seed), dummy);
+    }
+    doNotOptimizeAway(timer);
+}
+
+// steady state of MaxN timers, each iteration the clock goes 1ms forward,
+// expired timers are started again.
+// HashedWheelTimer is left out, its bucket check aborts on this logic clock.
+static void benchMixedHorizonTick(TimerSchedType timerType, benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    int restart = 0;
+    auto action = [&restart]() {
+        restart++;
+    };
+    for (int i = 0; i < MaxN; i++)
+    {
+        timer->Start(mixedHorizonDuration(seed), action);
+    }
+    for (auto _ : state)
+    {
+        Clock::TimeFly(1);
+        timer->Update(Clock::CurrentTimeMillis());
+        for (; restart > 0; restart--)
+        {
+            timer->Start(mixedHorizonDuration(seed), action);
+        }
+    }
+    Clock::TimeReset();
+    doNotOptimizeAway(timer);
+}
+
+static void BM_HashedWheelTimerMixedHorizonAdd(benchmark::State& state) {
+    benchMixedHorizonAdd(TimerSchedType::TIMER_HASHED_WHEEL, state);
+}
+
+static void BM_DAryHeapTimerMixedHorizonAdd(benchmark::State& state) {
+    benchMixedHorizonAdd(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerMixedHorizonAdd(benchmark::State& state) {
+    benchMixedHorizonAdd(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+static void BM_DAryHeapTimerMixedHorizonTick(benchmark::State& state) {
+    benchMixedHorizonTick(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerMixedHorizonTick(benchmark::State& state) {
+    benchMixedHorizonTick(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+BENCHMARK(BM_HashedWheelTimerMixedHorizonAdd);
+BENCHMARK(BM_DAryHeapTimerMixedHorizonAdd);
+BENCHMARK(BM_HybridWheelTimerMixedHorizonAdd);
+
+BENCHMARK(BM_DAryHeapTimerMixedHorizonTick);
+BENCHMARK(BM_HybridWheelTimerMixedHorizonTick);
+
+// phase-changing workload, the clock goes 1ms forward per iteration.
+// phase 0 starts short scattered timers, phase 1 refreshes keepalive timers
+// of a constant duration, phases take turns every 50000 iterations.
+static void benchPhaseChange(TimerSchedType timerType, benchmark::State& state)
+{
+    const int PhaseIters = 50000;
+    const int Conns = 20000;
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    auto dummy = []() {};
+    vector<int> conns(Conns);
+    int64_t iter = 0;
+    for (auto _ : state)
+    {
+        Clock::TimeFly(1);
+        timer->Update(Clock::CurrentTimeMillis());
+        if ((iter++ / PhaseIters) % 2 == 0) {
+            for (int i = 0; i < 10; i++) {
+                timer->Start(lcg_rand(seed) % 2000, dummy);
+            }
+        } else {
+            for (int i = 0; i < 10; i++) {
+                int k = (int)(((lcg_rand(seed) << 15) | lcg_rand(seed)) % Conns);
+                timer->Cancel(conns[k]);
+                conns[k] = timer->Start(30000, dummy);
+            }
+        }
+    }
+    Clock::TimeReset();
+    auto adaptive = dynamic_cast<AdaptiveTimer*>(timer.get());
+    if (adaptive != nullptr) {
+        state.counters["switches"] = (double)adaptive->DecisionLog().size();
+    }
+    doNotOptimizeAway(timer);
+}
+
+static void BM_DAryHeapTimerPhaseChange(benchmark::State& state) {
+    benchPhaseChange(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerPhaseChange(benchmark::State& state) {
+    benchPhaseChange(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+static void BM_DurationQueueTimerPhaseChange(benchmark::State& state) {
+    benchPhaseChange(TimerSchedType::TIMER_DURATION_QUEUE, state);
+}
+
+static void BM_AdaptiveTimerPhaseChange(benchmark::State& state) {
+    benchPhaseChange(TimerSchedType::TIMER_ADAPTIVE, state);
+}
+
+BENCHMARK(BM_DAryHeapTimerPhaseChange)->Iterations(1000000);
+BENCHMARK(BM_HybridWheelTimerPhaseChange)->Iterations(1000000);
+BENCHMARK(BM_DurationQueueTimerPhaseChange)->Iterations(1000000);
+BENCHMARK(BM_AdaptiveTimerPhaseChange)->Iterations(1000000);
+
+// cancel-dominated RPC workload, each iteration starts a 5s timer for a new
+// request and the oldest of 1000 in-flight requests completes, its timer is
+// canceled with `cancel%` chance. the clock goes 1ms forward every 16 requests.
+static void benchCancelRatio(TimerSchedType timerType, benchmark::State& state)
+{
+    const int InFlight = 1000;
+    const int cancel_percent = (int)state.range(0);
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    auto dummy = []() {};
+    vector<int> inflight(InFlight);
+    for (int i = 0; i < InFlight; i++)
+    {
+        inflight[i] = timer->Start(5000, dummy);
+    }
+    int64_t iter = 0;
+    for (auto _ : state)
+    {
+        int k = (int)(iter % InFlight);
+        if ((int)(lcg_rand(seed) % 100) < cancel_percent) {
+            timer->Cancel(inflight[k]);
+        }
+        inflight[k] = timer->Start(5000, dummy);
+        if (++iter % 16 == 0) {
+            Clock::TimeFly(1);
+            timer->Update(Clock::CurrentTimeMillis());
+        }
+    }
+    Clock::TimeReset();
+    doNotOptimizeAway(timer);
+}
+
+static void BM_PQTimerCancelRatio(benchmark::State& state) {
+    benchCancelRatio(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
+}
+
+static void BM_QuadHeapTimerCancelRatio(benchmark::State& state) {
+    benchCancelRatio(TimerSchedType::TIMER_QUAD_HEAP, state);
+}
+
+static void BM_DAryHeapTimerCancelRatio(benchmark::State& state) {
+    benchCancelRatio(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_BufferedHeapTimerCancelRatio(benchmark::State& state) {
+    benchCancelRatio(TimerSchedType::TIMER_BUFFERED_HEAP, state);
+}
+
+BENCHMARK(BM_PQTimerCancelRatio)->Arg(50)->Arg(90)->Arg(99);
+BENCHMARK(BM_QuadHeapTimerCancelRatio)->Arg(50)->Arg(90)->Arg(99);
+BENCHMARK(BM_DAryHeapTimerCancelRatio)->Arg(50)->Arg(90)->Arg(99);
+BENCHMARK(BM_BufferedHeapTimerCancelRatio)->Arg(50)->Arg(90)->Arg(99);
+
+// long-running churn over MaxN pending timers, each iteration cancels a random
+// timer and starts a new one, the clock goes 1ms forward every 64 iterations.
+// compaction ratio is `range(0)` percent, 100 disables compaction.
+static void BM_QuadHeapTimerChurn(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    QuadHeapTimer timer(state.range(0) / 100.0);
+    auto dummy = []() {};
+    vector<int> timer_ids(MaxN);
+    for (int i = 0; i < MaxN; i++)
+    {
+        timer_ids[i] = timer.Start(60000 + lcg_rand(seed) % 60000, dummy);
+    }
+    int64_t iter = 0;
+    int64_t update_ns = 0;
+    for (auto _ : state)
+    {
+        int k = (int)(((lcg_rand(seed) << 15) | lcg_rand(seed)) % MaxN);
+        timer.Cancel(timer_ids[k]);
+        timer_ids[k] = timer.Start(60000 + lcg_rand(seed) % 60000, dummy);
+        if (++iter % 64 == 0) {
+            Clock::TimeFly(1);
+            int64_t start = Clock::GetNowTickCount();
+            timer.Update(Clock::CurrentTimeMillis());
+            update_ns += Clock::GetNowTickCount() - start;
+        }
+    }
+    Clock::TimeReset();
+    state.counters["live"] = timer.LiveCount();
+    state.counters["dead"] = timer.DeadCount();
+    state.counters["update_ns"] = iter >= 64 ? (double)update_ns / (iter / 64) : 0;
+    doNotOptimizeAway(timer);
+}
+
+BENCHMARK(BM_QuadHeapTimerChurn)->Arg(25)->Arg(50)->Arg(100)->Iterations(2000000);
+
+// same churn as above, eager cancel vs. lazy cancel
+static void benchLazyCancelChurn(std::shared_ptr<TimerBase> timer, benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    auto dummy = []() {};
+    vector<int> timer_ids(MaxN);
+    for (int i = 0; i < MaxN; i++)
+    {
+        timer_ids[i] = timer->Start(60000 + lcg_rand(seed) % 60000, dummy);
+    }
+    int64_t iter = 0;
+    for (auto _ : state)
+    {
+        int k = (int)(((lcg_rand(seed) << 15) | lcg_rand(seed)) % MaxN);
+        timer->Cancel(timer_ids[k]);
+        timer_ids[k] = timer->Start(60000 + lcg_rand(seed) % 60000, dummy);
+        if (++iter % 64 == 0) {
+            Clock::TimeFly(1);
+            timer->Update(Clock::CurrentTimeMillis());
+        }
+    }
+    Clock::TimeReset();
+    doNotOptimizeAway(timer);
+}
+
+static void BM_PQTimerChurn(benchmark::State& state) {
+    benchLazyCancelChurn(std::make_shared<PriorityQueueTimer>(state.range(0) != 0), state);
+}
+
+static void BM_RBTreeTimerChurn(benchmark::State& state) {
+    benchLazyCancelChurn(std::make_shared<RBTreeTimer>(state.range(0) != 0), state);
+}
+
+// arg 0 is eager cancel, 1 is lazy cancel
+BENCHMARK(BM_PQTimerChurn)->Arg(0)->Arg(1)->Iterations(2000000);
+BENCHMARK(BM_RBTreeTimerChurn)->Arg(0)->Arg(1)->Iterations(2000000);
+
+// thundering herd, 100k timers share one deadline and expire in one Update
+static void benchThunderingHerd(TimerSchedType timerType, benchmark::State& state)
+{
+    const int N = 100000;
+    auto dummy = []() {};
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto timer = CreateTimer(timerType);
+        int64_t deadline = Clock::CurrentTimeMillis() + 1000;
+        for (int i = 0; i < N; i++)
+        {
+            uint32_t duration = (uint32_t)(deadline - Clock::CurrentTimeMillis());
+            timer->Start(duration, dummy);
+        }
+        state.ResumeTiming();
+
+        int fired = timer->Update(deadline);
+
+        state.PauseTiming();
+        doNotOptimizeAway(fired);
+        timer.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_PQTimerThunderingHerd(benchmark::State& state) {
+    benchThunderingHerd(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
+}
+
+static void BM_QuadHeapTimerThunderingHerd(benchmark::State& state) {
+    benchThunderingHerd(TimerSchedType::TIMER_QUAD_HEAP, state);
+}
+
+static void BM_DAryHeapTimerThunderingHerd(benchmark::State& state) {
+    benchThunderingHerd(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_CoalescedHeapTimerThunderingHerd(benchmark::State& state) {
+    benchThunderingHerd(TimerSchedType::TIMER_COALESCED_HEAP, state);
+}
+
+BENCHMARK(BM_PQTimerThunderingHerd)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QuadHeapTimerThunderingHerd)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DAryHeapTimerThunderingHerd)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CoalescedHeapTimerThunderingHerd)->Unit(benchmark::kMillisecond);
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline int64_t readCycles() { return (int64_t)__rdtsc(); }
+#else
+static inline int64_t readCycles() { return Clock::GetNowTickCount(); } // ns instead
+#endif
+
+// callback payload, each callback touches its own cache line
+struct alignas(64) DispatchPayload
+{
+    int64_t counter = 0;
+    int64_t sum = 0;
+    int64_t values[6] = {};
+};
+
+// MaxN timers spread over 100ms expire in one Update, callbacks are of 4 distinct types
+// and touch scattered payloads. reports cycles per fired timer, grouping is `range(0)`.
+static void benchDispatch(TimerSchedType timerType, benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345);
+    vector<DispatchPayload> payloads(MaxN);
+    vector<DispatchPayload*> order(MaxN);
+    for (int i = 0; i < MaxN; i++) {
+        order[i] = &payloads[i];
+    }
+    std::random_shuffle(order.begin(), order.end());
+    int64_t cycles = 0;
+    int64_t fired = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto timer = CreateTimer(timerType);
+        timer->SetDispatchGrouping(state.range(0) != 0);
+        for (int i = 0; i < MaxN; i++)
+        {
+            DispatchPayload* p = order[i];
+            uint32_t duration = lcg_rand(seed) % 100;
+            switch (i % 4) {
+            case 0: timer->Start(duration, [p]() { p->counter++; }); break;
+            case 1: timer->Start(duration, [p]() { p->sum += p->counter; }); break;
+            case 2: timer->Start(duration, [p]() { p->values[p->counter & 5] ^= p->sum; }); break;
+            default: timer->Start(duration, [p]() { p->values[0] += p->values[1] * 3; }); break;
+            }
+        }
+        state.ResumeTiming();
+
+        int64_t start = readCycles();
+        fired += timer->Update(Clock::CurrentTimeMillis() + 100);
+        cycles += readCycles() - start;
+
+        state.PauseTiming();
+        timer.reset();
+        state.ResumeTiming();
+    }
+    state.counters["cycles"] = fired > 0 ? (double)cycles / fired : 0;
+    state.SetItemsProcessed(fired);
+    doNotOptimizeAway(payloads);
+}
+
+static void BM_RBTreeTimerDispatch(benchmark::State& state) {
+    benchDispatch(TimerSchedType::TIMER_RBTREE, state);
+}
+
+static void BM_DAryHeapTimerDispatch(benchmark::State& state) {
+    benchDispatch(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerDispatch(benchmark::State& state) {
+    benchDispatch(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+// arg 0 dispatches in deadline order, 1 groups callbacks by type
+BENCHMARK(BM_RBTreeTimerDispatch)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DAryHeapTimerDispatch)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HybridWheelTimerDispatch)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// MaxN timers spread over 100ms expire at once, handled by callbacks of Update()
+// when `range(0)` is 0, or drained by PollExpired() into a 256-entry buffer when 1.
+static void benchPollExpired(TimerSchedType timerType, benchmark::State& state)
+{
+    const bool poll = state.range(0) != 0;
+    uint32_t seed = lcg_seed(12345);
+    ExpiredEntry out[256];
+    uint64_t sum = 0;
+    int64_t handled = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto timer = CreateTimer(timerType);
+        for (int i = 0; i < MaxN; i++)
+        {
+            uint32_t duration = lcg_rand(seed) % 100;
+            if (poll) {
+                timer->StartPoll(duration, (uint64_t)i);
+            } else {
+                timer->Start(duration, [&sum, i]() { sum += i; });
+            }
+        }
+        int64_t now = Clock::CurrentTimeMillis() + 100;
+        state.ResumeTiming();
+
+        if (poll) {
+            int n = 0;
+            while ((n = timer->PollExpired(now, out, 256)) > 0) {
+                for (int i = 0; i < n; i++) {
+                    sum += out[i].cookie;
+                }
+                handled += n;
+            }
+        } else {
+            handled += timer->Update(now);
+        }
+
+        state.PauseTiming();
+        timer.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(handled);
+    doNotOptimizeAway(sum);
+}
+
+static void BM_PQTimerPollExpired(benchmark::State& state) {
+    benchPollExpired(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
+}
+
+static void BM_RBTreeTimerPollExpired(benchmark::State& state) {
+    benchPollExpired(TimerSchedType::TIMER_RBTREE, state);
+}
+
+static void BM_DAryHeapTimerPollExpired(benchmark::State& state) {
+    benchPollExpired(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerPollExpired(benchmark::State& state) {
+    benchPollExpired(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+// arg 0 is callback mode, 1 is pull mode
+BENCHMARK(BM_PQTimerPollExpired)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RBTreeTimerPollExpired)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DAryHeapTimerPollExpired)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HybridWheelTimerPollExpired)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// 200k timers re-armed in callbacks over a 10s horizon, the clock goes 1ms forward per
+// iteration and stalls 1s every 1000 iterations. reports worst and mean latency of one
+// Update call, `range(0)` 0 is unbounded, 1 limits to 1024 fired, 2 limits to 200us.
+static void benchBoundedUpdate(TimerSchedType timerType, benchmark::State& state)
+{
+    const int N = 200000;
+    const int Horizon = 10000;
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    TimerBase* raw = timer.get();
+    std::function<void()> rearm;
+    rearm = [raw, &seed, &rearm]() {
+        raw->Start(lcg_rand(seed) % Horizon, rearm);
+    };
+    for (int i = 0; i < N; i++)
+    {
+        timer->Start(lcg_rand(seed) % Horizon, rearm);
+    }
+    UpdateBudget budget;
+    if (state.range(0) == 1) {
+        budget.max_fired = 1024;
+    } else if (state.range(0) == 2) {
+        budget.max_ns = 200000;
+    }
+    int64_t iter = 0;
+    int64_t worst_ns = 0;
+    int64_t total_ns = 0;
+    int64_t backlog = 0;
+    for (auto _ : state)
+    {
+        Clock::TimeFly(++iter % 1000 == 0 ? 1000 : 1);
+        int64_t start = Clock::GetNowTickCount();
+        if (state.range(0) == 0) {
+            timer->Update(Clock::CurrentTimeMillis());
+        } else {
+            backlog += timer->Update(Clock::CurrentTimeMillis(), budget).backlog;
+        }
+        int64_t elapsed = Clock::GetNowTickCount() - start;
+        total_ns += elapsed;
+        worst_ns = std::max(worst_ns, elapsed);
+    }
+    Clock::TimeReset();
+    state.counters["worst_us"] = worst_ns / 1000.0;
+    state.counters["mean_us"] = iter > 0 ? total_ns / 1000.0 / iter : 0;
+    state.counters["backlog"] = iter > 0 ? (double)backlog / iter : 0;
+    doNotOptimizeAway(timer);
+}
+
+static void BM_PQTimerBoundedUpdate(benchmark::State& state) {
+    benchBoundedUpdate(TimerSchedType::TIMER_PRIORITY_QUEUE, state);
+}
+
+static void BM_HHWheelTimerBoundedUpdate(benchmark::State& state) {
+    benchBoundedUpdate(TimerSchedType::TIMER_HH_WHEEL, state);
+}
+
+static void BM_DAryHeapTimerBoundedUpdate(benchmark::State& state) {
+    benchBoundedUpdate(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerBoundedUpdate(benchmark::State& state) {
+    benchBoundedUpdate(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+BENCHMARK(BM_PQTimerBoundedUpdate)->Arg(0)->Arg(1)->Arg(2)->Iterations(5000);
+BENCHMARK(BM_HHWheelTimerBoundedUpdate)->Arg(0)->Arg(1)->Arg(2)->Iterations(5000);
+BENCHMARK(BM_DAryHeapTimerBoundedUpdate)->Arg(0)->Arg(1)->Arg(2)->Iterations(5000);
+BENCHMARK(BM_HybridWheelTimerBoundedUpdate)->Arg(0)->Arg(1)->Arg(2)->Iterations(5000);
+
+// 10k heartbeat timers of 1s-2s re-armed in callbacks with `range(0)` ms slack,
+// the clock goes 1ms forward per iteration, an Update firing any timer counts a wakeup.
+static void benchSlack(TimerSchedType timerType, benchmark::State& state)
+{
+    const int N = 10000;
+    uint32_t slack = (uint32_t)state.range(0);
+    uint32_t seed = lcg_seed(12345);
+    auto timer = CreateTimer(timerType);
+    TimerBase* raw = timer.get();
+    std::function<void()> rearm;
+    rearm = [raw, slack, &seed, &rearm]() {
+        raw->Start(1000 + lcg_rand(seed) % 1000, rearm, slack);
+    };
+    for (int i = 0; i < N; i++)
+    {
+        timer->Start(1000 + lcg_rand(seed) % 1000, rearm, slack);
+    }
+    int64_t iter = 0;
+    int64_t wakeups = 0;
+    int64_t fired = 0;
+    for (auto _ : state)
+    {
+        Clock::TimeFly(1);
+        int n = timer->Update(Clock::CurrentTimeMillis());
+        if (n > 0) {
+            wakeups++;
+            fired += n;
+        }
+        iter++;
+    }
+    Clock::TimeReset();
+    state.counters["wakeup_ratio"] = iter > 0 ? (double)wakeups / iter : 0;
+    state.counters["fired_per_wakeup"] = wakeups > 0 ? (double)fired / wakeups : 0;
+    doNotOptimizeAway(timer);
+}
+
+static void BM_HHWheelTimerSlack(benchmark::State& state) {
+    benchSlack(TimerSchedType::TIMER_HH_WHEEL, state);
+}
+
+static void BM_DAryHeapTimerSlack(benchmark::State& state) {
+    benchSlack(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HybridWheelTimerSlack(benchmark::State& state) {
+    benchSlack(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+BENCHMARK(BM_HHWheelTimerSlack)->Arg(0)->Arg(16)->Arg(50)->Iterations(20000);
+BENCHMARK(BM_DAryHeapTimerSlack)->Arg(0)->Arg(16)->Arg(50)->Iterations(20000);
+BENCHMARK(BM_HybridWheelTimerSlack)->Arg(0)->Arg(16)->Arg(50)->Iterations(20000);
+
+// 100k timers re-armed in callbacks, 90% are session timers of 10s-60s tolerating 1s,
+// 10% are rpc deadlines of 50ms-500ms, the clock goes 1ms forward per iteration.
+// `range(0)` 0 starts all timers exact, 1 passes the precision hint.
+static void benchPrecision(TimerSchedType exactType, benchmark::State& state)
+{
+    const int N = 100000;
+    bool hinted = state.range(0) != 0;
+    uint32_t seed = lcg_seed(12345);
+    PrecisionTimer timer(exactType);
+    std::function<void()> session;
+    std::function<void()> rpc;
+    session = [&]() {
+        timer.Start(10000 + lcg_rand(seed) % 50000, session, hinted ? Precision::Coarse1s : Precision::Exact);
+    };
+    rpc = [&]() {
+        timer.Start(50 + lcg_rand(seed) % 450, rpc, Precision::Exact);
+    };
+    for (int i = 0; i < N; i++)
+    {
+        if (i % 10 == 0) {
+            rpc();
+        } else {
+            session();
+        }
+    }
+    for (auto _ : state)
+    {
+        Clock::TimeFly(1);
+        timer.Update(Clock::CurrentTimeMillis());
+    }
+    Clock::TimeReset();
+    state.counters["coarse"] = timer.CoarseSize();
+}
+
+static void BM_DAryHeapTimerPrecision(benchmark::State& state) {
+    benchPrecision(TimerSchedType::TIMER_DARY_HEAP, state);
+}
+
+static void BM_HHWheelTimerPrecision(benchmark::State& state) {
+    benchPrecision(TimerSchedType::TIMER_HH_WHEEL, state);
+}
+
+static void BM_HybridWheelTimerPrecision(benchmark::State& state) {
+    benchPrecision(TimerSchedType::TIMER_HYBRID_WHEEL, state);
+}
+
+BENCHMARK(BM_DAryHeapTimerPrecision)->Arg(0)->Arg(1)->Iterations(60000);
+BENCHMARK(BM_HHWheelTimerPrecision)->Arg(0)->Arg(1)->Iterations(60000);
+BENCHMARK(BM_HybridWheelTimerPrecision)->Arg(0)->Arg(1)->Iterations(60000);
+
+// an owner thread updates every 1ms while benchmark threads start timers of 100ms-1s
+// and cancel every other one.
+static std::atomic<bool> owner_stop(false);
+static std::thread owner_thread;
+static std::shared_ptr<CommandQueueTimer> queued_timer;
+static std::shared_ptr<DAryHeapTimer<4>> locked_timer;
+static std::mutex timer_mutex;
+
+static void startQueueOwner(const benchmark::State&)
+{
+    queued_timer.reset(new CommandQueueTimer());
+    owner_stop = false;
+    owner_thread = std::thread([]() {
+        queued_timer->BindOwnerThread();
+        while (!owner_stop) {
+            queued_timer->Update(Clock::CurrentTimeMillis());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+static void startLockedOwner(const benchmark::State&)
+{
+    locked_timer.reset(new DAryHeapTimer<4>());
+    owner_stop = false;
+    owner_thread = std::thread([]() {
+        while (!owner_stop) {
+            {
+                std::lock_guard<std::mutex> guard(timer_mutex);
+                locked_timer->Update(Clock::CurrentTimeMillis());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+static void stopOwner(const benchmark::State&)
+{
+    owner_stop = true;
+    owner_thread.join();
+    queued_timer.reset();
+    locked_timer.reset();
+}
+
+static void BM_CommandQueueTimerProducers(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        int id = queued_timer->Start(100 + lcg_rand(seed) % 900, []() {});
+        if (ops++ % 2 == 1) {
+            queued_timer->Cancel(id);
+        }
+    }
+    state.SetItemsProcessed(ops);
+}
+
+static void BM_MutexDAryHeapTimerProducers(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        std::lock_guard<std::mutex> guard(timer_mutex);
+        int id = locked_timer->Start(100 + lcg_rand(seed) % 900, []() {});
+        if (ops++ % 2 == 1) {
+            locked_timer->Cancel(id);
+        }
+    }
+    state.SetItemsProcessed(ops);
+}
+
+BENCHMARK(BM_CommandQueueTimerProducers)->Setup(startQueueOwner)->Teardown(stopOwner)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_MutexDAryHeapTimerProducers)->Setup(startLockedOwner)->Teardown(stopOwner)->ThreadRange(1, 32)->UseRealTime();
+
+// same as above for wheels, timers of 10ms-100ms keep the arena from running out
+static std::shared_ptr<ConcurrentHashedWheelTimer> concurrent_wheel;
+static std::shared_ptr<HashedWheelTimer> locked_wheel;
+
+static void startConcurrentWheelOwner(const benchmark::State&)
+{
+    concurrent_wheel.reset(new ConcurrentHashedWheelTimer());
+    owner_stop = false;
+    owner_thread = std::thread([]() {
+        while (!owner_stop) {
+            concurrent_wheel->Update(Clock::CurrentTimeMillis());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+static void startLockedWheelOwner(const benchmark::State&)
+{
+    locked_wheel.reset(new HashedWheelTimer());
+    owner_stop = false;
+    owner_thread = std::thread([]() {
+        while (!owner_stop) {
+            {
+                std::lock_guard<std::mutex> guard(timer_mutex);
+                locked_wheel->Update(Clock::CurrentTimeMillis());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+static void stopWheelOwner(const benchmark::State&)
+{
+    owner_stop = true;
+    owner_thread.join();
+    concurrent_wheel.reset();
+    locked_wheel.reset();
+}
+
+static void BM_ConcurrentHashedWheelTimerProducers(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        // a canceled timeout keeps its slot until its tick, wait for a starved ticker
+        // before the arena is full
+        while (concurrent_wheel->Size() > (1 << 18)) {
+            std::this_thread::yield();
+        }
+        int id = concurrent_wheel->Start(10 + lcg_rand(seed) % 90, []() {});
+        if (ops++ % 2 == 1) {
+            concurrent_wheel->Cancel(id);
+        }
+    }
+    state.SetItemsProcessed(ops);
+}
+
+static void BM_MutexHashedWheelTimerProducers(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        std::lock_guard<std::mutex> guard(timer_mutex);
+        int id = locked_wheel->Start(10 + lcg_rand(seed) % 90, []() {});
+        if (ops++ % 2 == 1) {
+            locked_wheel->Cancel(id);
+        }
+    }
+    state.SetItemsProcessed(ops);
+}
+
+BENCHMARK(BM_ConcurrentHashedWheelTimerProducers)->Setup(startConcurrentWheelOwner)->Teardown(stopWheelOwner)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_MutexHashedWheelTimerProducers)->Setup(startLockedWheelOwner)->Teardown(stopWheelOwner)->ThreadRange(1, 32)->UseRealTime();
+
+// every benchmark thread is a worker of a shared pool, it starts a timer of 1ms-5ms
+// then fires due timers, reports average lateness of fired timers in milliseconds.
+static std::shared_ptr<StripedTimer> striped_timer;
+static std::shared_ptr<QuadHeapTimer> shared_quad;
+static std::atomic<int64_t> late_sum(0);
+static std::atomic<int64_t> late_count(0);
+
+struct LatenessProbe
+{
+    int64_t deadline;
+
+    void operator()() const
+    {
+        late_sum += Clock::CurrentTimeMillis() - deadline;
+        late_count++;
+    }
+};
+
+static void startStripedWorkers(const benchmark::State&)
+{
+    striped_timer.reset(new StripedTimer());
+    late_sum = 0;
+    late_count = 0;
+}
+
+static void startLockedWorkers(const benchmark::State&)
+{
+    shared_quad.reset(new QuadHeapTimer());
+    late_sum = 0;
+    late_count = 0;
+}
+
+static void stopWorkers(const benchmark::State&)
+{
+    striped_timer.reset();
+    shared_quad.reset();
+}
+
+static void reportLateness(benchmark::State& state, int64_t ops)
+{
+    state.SetItemsProcessed(ops);
+    int64_t count = late_count.load();
+    state.counters["late_ms"] = benchmark::Counter(count > 0 ? (double)late_sum.load() / count : 0,
+        benchmark::Counter::kAvgThreads);
+}
+
+static void BM_StripedTimerWorkers(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        uint32_t duration = 1 + lcg_rand(seed) % 5;
+        striped_timer->Start(duration, LatenessProbe{Clock::CurrentTimeMillis() + duration});
+        striped_timer->Update(Clock::CurrentTimeMillis());
+        ops++;
+    }
+    reportLateness(state, ops);
+}
+
+static void BM_MutexQuadHeapTimerWorkers(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        uint32_t duration = 1 + lcg_rand(seed) % 5;
+        std::lock_guard<std::mutex> guard(timer_mutex);
+        shared_quad->Start(duration, LatenessProbe{Clock::CurrentTimeMillis() + duration});
+        shared_quad->Update(Clock::CurrentTimeMillis());
+        ops++;
+    }
+    reportLateness(state, ops);
+}
+
+BENCHMARK(BM_StripedTimerWorkers)->Setup(startStripedWorkers)->Teardown(stopWorkers)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_MutexQuadHeapTimerWorkers)->Setup(startLockedWorkers)->Teardown(stopWorkers)->ThreadRange(1, 32)->UseRealTime();
+
+// an owner thread starts 10k timers of about 1 minute then updates every 1ms,
+// benchmark threads reschedule random timers of it.
+// the locked quad heap reschedules by cancel and start again.
+const int RESET_TIMERS = 10000;
+static std::shared_ptr<GoTimerHeap> go_timer;
+static std::shared_ptr<QuadHeapTimer> locked_quad;
+static std::vector<int64_t> go_reset_ids;
+static std::vector<int> reset_ids;
+static std::atomic<bool> owner_ready(false);
+
+static void startGoTimerOwner(const benchmark::State&)
+{
+    go_timer.reset(new GoTimerHeap());
+    owner_stop = false;
+    owner_ready = false;
+    owner_thread = std::thread([]() {
+        go_reset_ids.clear();
+        for (int i = 0; i < RESET_TIMERS; i++) {
+            go_reset_ids.push_back(go_timer->Start(60000 + i % 1000, []() {}));
+        }
+        owner_ready = true;
+        while (!owner_stop) {
+            go_timer->Update(Clock::CurrentTimeMillis());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    while (!owner_ready) {
+        std::this_thread::yield();
+    }
+}
+
+static void startLockedQuadOwner(const benchmark::State&)
+{
+    locked_quad.reset(new QuadHeapTimer());
+    reset_ids.clear();
+    for (int i = 0; i < RESET_TIMERS; i++) {
+        reset_ids.push_back(locked_quad->Start(60000 + i % 1000, []() {}));
+    }
+    owner_stop = false;
+    owner_thread = std::thread([]() {
+        while (!owner_stop) {
+            {
+                std::lock_guard<std::mutex> guard(timer_mutex);
+                locked_quad->Update(Clock::CurrentTimeMillis());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+static void stopResetOwner(const benchmark::State&)
+{
+    owner_stop = true;
+    owner_thread.join();
+    go_timer.reset();
+    locked_quad.reset();
+}
+
+static void BM_GoTimerHeapReset(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    for (auto _ : state)
+    {
+        int i = lcg_rand(seed) % RESET_TIMERS;
+        go_timer->Reset(go_reset_ids[i], 59000 + lcg_rand(seed) % 2000);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_MutexQuadHeapTimerReset(benchmark::State& state)
+{
+    uint32_t seed = lcg_seed(12345 + state.thread_index());
+    for (auto _ : state)
+    {
+        int i = lcg_rand(seed) % RESET_TIMERS;
+        uint32_t duration = 59000 + lcg_rand(seed) % 2000;
+        std::lock_guard<std::mutex> guard(timer_mutex);
+        locked_quad->Cancel(reset_ids[i]);
+        reset_ids[i] = locked_quad->Start(duration, []() {});
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_GoTimerHeapReset)->Setup(startGoTimerOwner)->Teardown(stopResetOwner)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_MutexQuadHeapTimerReset)->Setup(startLockedQuadOwner)->Teardown(stopResetOwner)->ThreadRange(1, 32)->UseRealTime();
+
+// `range(0)` consumers take 500 items of 1ms-20ms delay put one per millisecond,
+// `range(1)` is 1 for leader-follower, 0 for all consumers waiting on head deadline.
+// reports consumer wakeups per item and average lateness of taken items in microseconds.
+static void BM_DelayQueueConsumers(benchmark::State& state)
+{
+    const int N = 500;
+    int consumers = (int)state.range(0);
+    int64_t wakeups = 0;
+    int64_t late_ns = 0;
+    for (auto _ : state)
+    {
+        DelayQueue<int64_t> queue(state.range(1) == 1);
+        std::atomic<int64_t> late(0);
+        std::atomic<int> taken(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < consumers; i++)
+        {
+            threads.emplace_back([&]() {
+                int64_t deadline_ns = 0;
+                while (queue.Take(deadline_ns)) {
+                    int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+                    late += now_ns - deadline_ns;
+                    taken++;
+                }
+            });
+        }
+        uint32_t seed = lcg_seed(12345);
+        for (int i = 0; i < N; i++)
+        {
+            uint32_t delay = 1 + lcg_rand(seed) % 20;
+            queue.Put(delay, (Clock::CurrentTimeMillis() + delay) * 1000000);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        while (taken < N)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        queue.Close();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        wakeups += queue.Wakeups();
+        late_ns += late;
+    }
+    int64_t items = state.iterations() * N;
+    state.counters["wakeups/item"] = (double)wakeups / items;
+    state.counters["late_us"] = late_ns / 1000.0 / items;
+}
+
+BENCHMARK(BM_DelayQueueConsumers)->ArgsProduct({{1, 2, 4, 8, 16}, {0, 1}})->Iterations(3)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// a callback of some work, records its delay since the tick started
+struct DispatchProbe
+{
+    int64_t* latency;
+    const int64_t* tick_start;
+
+    void operator()() const
+    {
+        uint32_t seed = (uint32_t)(uintptr_t)latency;
+        for (int i = 0; i < 100; i++) {
+            seed = lcg_rand(seed);
+        }
+        benchmark::DoNotOptimize(seed);
+        *latency = Clock::GetNowTickCount() - *tick_start;
+    }
+};
+
+// one tick fires 20k callbacks, `range(0)` is 0 for inline dispatch or executor threads,
+// reports p50 and p99 delay from the start of tick to callback run in microseconds.
+static void BM_TimerExecutorDispatch(benchmark::State& state)
+{
+    const int N = 20000;
+    int threads = (int)state.range(0);
+    std::shared_ptr<TimerExecutor> executor;
+    if (threads > 0) {
+        executor = std::make_shared<TimerExecutor>(threads);
+    }
+    std::vector<int64_t> latency(N);
+    std::vector<int64_t> all;
+    int64_t tick_start = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        DAryHeapTimer<4> timer;
+        timer.SetExecutor(executor);
+        for (int i = 0; i < N; i++)
+        {
+            timer.Start(0, DispatchProbe{&latency[i], &tick_start});
+        }
+        int64_t now = Clock::CurrentTimeMillis() + 1;
+        state.ResumeTiming();
+
+        tick_start = Clock::GetNowTickCount();
+        timer.Update(now);
+        if (executor) {
+            executor->Wait();
+        }
+
+        state.PauseTiming();
+        all.insert(all.end(), latency.begin(), latency.end());
+        state.ResumeTiming();
+    }
+    std::sort(all.begin(), all.end());
+    state.SetItemsProcessed(state.iterations() * N);
+    state.counters["p50_us"] = all[all.size() / 2] / 1000.0;
+    state.counters["p99_us"] = all[all.size() * 99 / 100] / 1000.0;
+}
+
+BENCHMARK(BM_TimerExecutorDispatch)->Arg(0)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Iterations(20)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// upper bound in microseconds of the bucket holding the `pct` percentile of fired timers
+static int64_t latenessPercentile(const TimerThreadStats& stats, int pct)
+{
+    int64_t rank = stats.fired * pct / 100;
+    int64_t seen = 0;
+    for (int i = 0; i < LATENESS_BUCKETS; i++)
+    {
+        seen += stats.lateness[i];
+        if (seen > rank) {
+            return 1LL << i;
+        }
+    }
+    return 1LL << (LATENESS_BUCKETS - 1);
+}
+
+// a producer starts one timer of 1ms-10ms every millisecond on a ticker thread,
+// `range(0)` is the tick mode of sleep, hybrid or busy-poll.
+// reports p50 and p99 lateness in microseconds and wakeups per fired timer,
+// the process CPU time shows the cost of spinning.
+static void BM_TimerThreadMode(benchmark::State& state)
+{
+    const int N = 200;
+    TickMode mode = (TickMode)state.range(0);
+    TimerThreadStats total;
+    for (auto _ : state)
+    {
+        TimerThread driver(std::make_shared<DAryHeapTimer<4>>(), mode);
+        driver.Run();
+        uint32_t seed = lcg_seed(N);
+        for (int i = 0; i < N; i++)
+        {
+            seed = lcg_rand(seed);
+            driver.Start(1 + seed % 10, nullptr);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        while (driver.Size() > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        driver.Stop();
+        TimerThreadStats stats = driver.Stats();
+        total.fired += stats.fired;
+        total.wakeups += stats.wakeups;
+        for (int i = 0; i < LATENESS_BUCKETS; i++)
+        {
+            total.lateness[i] += stats.lateness[i];
+        }
+    }
+    state.SetItemsProcessed(total.fired);
+    state.counters["p50_us"] = (double)latenessPercentile(total, 50);
+    state.counters["p99_us"] = (double)latenessPercentile(total, 99);
+    state.counters["wakeup/fire"] = (double)total.wakeups / total.fired;
+}
+
+BENCHMARK(BM_TimerThreadMode)->Arg(0)->Arg(1)->Arg(2)->Iterations(3)->MeasureProcessCPUTime()->UseRealTime()->Unit(benchmark::kMillisecond);
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+// timer of an I/O session, records lateness to its millisecond deadline then signals the session's eventfd
+struct LoopProbe
+{
+    int fd;
+    int64_t deadline;
+    std::vector<int64_t>* lateness;
+
+    void operator()() const
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        lateness->push_back(now - deadline * 1000000);
+        uint64_t one = 1;
+        ssize_t n = write(fd, &one, sizeof(one));
+        benchmark::DoNotOptimize(n);
+    }
+};
+
+// 64 sessions each own an eventfd, a readable eventfd starts the next timer of 1ms-10ms of its session,
+// `range(0)` is 0 for timerfd and 1 for epoll_wait timeout.
+// reports syscalls of the loop per fired timer and p50/p99 lateness in microseconds.
+static void BM_EventLoopTimers(benchmark::State& state)
+{
+    const int Sessions = 64;
+    LoopTimerMode mode = (LoopTimerMode)state.range(0);
+    std::vector<int64_t> lateness;
+    EventLoopStats total;
+    for (auto _ : state)
+    {
+        EventLoop loop(std::make_shared<DAryHeapTimer<4>>(), mode);
+        std::vector<int> fds(Sessions);
+        uint32_t seed = lcg_seed(Sessions);
+        for (int i = 0; i < Sessions; i++)
+        {
+            int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            fds[i] = fd;
+            loop.AddFd(fd, EPOLLIN, [&, fd](uint32_t) {
+                uint64_t count = 0;
+                ssize_t n = read(fd, &count, sizeof(count));
+                benchmark::DoNotOptimize(n);
+                seed = lcg_rand(seed);
+                uint32_t delay = 1 + seed % 10;
+                loop.Start(delay, LoopProbe{fd, Clock::CurrentTimeMillis() + delay, &lateness});
+            });
+            loop.Start(1 + i % 10, LoopProbe{fd, Clock::CurrentTimeMillis() + 1 + i % 10, &lateness});
+        }
+        int64_t end = Clock::CurrentTimeMillis() + 200;
+        while (Clock::CurrentTimeMillis() < end)
+        {
+            loop.RunOnce(10);
+        }
+        EventLoopStats stats = loop.Stats();
+        total.polls += stats.polls;
+        total.arms += stats.arms;
+        total.reads += stats.reads;
+        total.writes += stats.writes;
+        total.fired += stats.fired;
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+    }
+    std::sort(lateness.begin(), lateness.end());
+    state.SetItemsProcessed(total.fired);
+    state.counters["syscall/fire"] = (double)total.Syscalls() / total.fired;
+    state.counters["arm/fire"] = (double)total.arms / total.fired;
+    state.counters["p50_us"] = lateness[lateness.size() / 2] / 1000.0;
+    state.counters["p99_us"] = lateness[lateness.size() * 99 / 100] / 1000.0;
+}
+
+BENCHMARK(BM_EventLoopTimers)->Arg(0)->Arg(1)->Iterations(3)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+#endif // __linux__
+
+#if defined(__cpp_impl_coroutine)
+
+template <typename Timer>
+static Task<> sleepOnce(Timer& timer, uint32_t duration, int* count)
+{
+    co_await Sleep(timer, duration);
+    (*count)++;
+}
+
+template <typename Timer>
+static void benchCoroutineSleep(Timer& timer, benchmark::State& state)
+{
+    const int N = 1000000;
+    std::vector<Task<>> tasks;
+    tasks.reserve(N);
+    int count = 0;
+    for (int i = 0; i < N; i++)
+    {
+        tasks.push_back(sleepOnce(timer, 1 + i % 100, &count));
+        tasks.back().Start();
+    }
+    int64_t now = Clock::CurrentTimeMillis();
+    for (int64_t t = now; t <= now + 101; t++)
+    {
+        timer.Update(t);
+    }
+    while (timer.Size() > 0)
+    {
+        // adaptive timer migrates a batch per update, to a backend started at the real clock
+        timer.Update(std::max(now + 101, Clock::CurrentTimeMillis()));
+    }
+    if (count != N) {
+        state.SkipWithError("coroutines not resumed");
+    }
+}
+
+// a million coroutines sleep 1ms-100ms then resume, `range(0)` is 0 for the intrusive awaiter
+// on IntrusiveRBTreeTimer, or a `TimerSchedType` for `Start()` based awaiter.
+static void BM_CoroutineSleep(benchmark::State& state)
+{
+    int type = (int)state.range(0);
+    for (auto _ : state)
+    {
+        if (type == 0) {
+            IntrusiveRBTreeTimer timer;
+            benchCoroutineSleep(timer, state);
+        } else {
+            auto timer = CreateTimer((TimerSchedType)type);
+            benchCoroutineSleep(*timer, state);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1000000);
+}
+
+BENCHMARK(BM_CoroutineSleep)->DenseRange(0, 15)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+#endif // __cpp_impl_coroutine
+
+// re-arms itself on current shard, and starts then cancels a timer on a random shard
+struct ShardLoad
+{
+    ShardedTimerService* service;
+
+    void operator()() const
+    {
+        static thread_local uint32_t seed = lcg_seed(service->CurrentShard() + 1);
+        service->Start(1 + lcg_rand(seed) % 10, *this);
+        int64_t other = service->StartOn(lcg_rand(seed) % service->ShardCount(), 1000, nullptr);
+        service->Cancel(other);
+    }
+};
+
+// `range(0)` shards each run 10k self re-arming timers of 1ms-10ms,
+// reports aggregate start, cancel and fire per second.
+static void BM_ShardedTimerServiceScaling(benchmark::State& state)
+{
+    const int N = 10000;
+    int shards = (int)state.range(0);
+    ShardedTimerService service(shards, TimerSchedType::TIMER_HYBRID_WHEEL);
+    service.Run();
+    for (int i = 0; i < shards; i++)
+    {
+        for (int j = 0; j < N; j++)
+        {
+            service.StartOn(i, 1 + j % 10, ShardLoad{&service});
+        }
+    }
+    int64_t start = Clock::GetNowTickCount();
+    for (auto _ : state)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    service.Shutdown();
+    double seconds = (Clock::GetNowTickCount() - start) / 1e9;
+    ShardStats total;
+    for (int i = 0; i < shards; i++)
+    {
+        ShardStats stats = service.Stats(i);
+        total.starts += stats.starts;
+        total.cancels += stats.cancels;
+        total.fires += stats.fires;
+    }
+    state.counters["start/s"] = total.starts / seconds;
+    state.counters["cancel/s"] = total.cancels / seconds;
+    state.counters["fire/s"] = total.fires / seconds;
+}
+
+BENCHMARK(BM_ShardedTimerServiceScaling)->RangeMultiplier(2)->Range(1, 16)->Iterations(5)->UseRealTime()->Unit(benchmark::kMillisecond);
 
@@ -3,14 +3,43 @@
 
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <numeric>
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <unordered_map>
 #include <memory>
 #include <gtest/gtest.h>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
 #include "Clock.h"
 #include "TimerBase.h"
+#include "IntrusiveRBTreeTimer.h"
+#include "DAryHeapTimer.h"
+#include "CoalescedHeapTimer.h"
+#include "DurationQueueTimer.h"
+#include "QuadHeapTimer.h"
+#include "HybridWheelTimer.h"
+#include "AdaptiveTimer.h"
+#include "BufferedHeapTimer.h"
+#include "PrecisionTimer.h"
+#include "CommandQueueTimer.h"
+#include "ShardedTimerService.h"
+#include "ConcurrentHashedWheelTimer.h"
+#include "StripedTimer.h"
+#include "GoTimerHeap.h"
+#include "DelayQueue.h"
+#include "TimerExecutor.h"
+#include "TimerThread.h"
+#include "EventLoop.h"
+#include "TimerCoroutine.h"
+#include "PriorityQueueTimer.h"
+#include "RBTreeTimer.h"
+#include "HashedWheelTimer.h"
+#include "HHWheelTimer.h"
 #include "Preprocessor.h"
 
 using namespace std;
@@ -161,6 +190,316 @@ static void TestTimerExpireFIFO(TimerBase *timer) {
 }
 
 
+// timers due in the same tick are paired, whichever fires first cancels the other
+static void TestTimerCancelInBatch(TimerBase* timer, int count) {
+    std::vector<int> ids;
+    int called = 0;
+    for (int i = 0; i < count; i++) {
+        int partner = i ^ 1;
+        ids.push_back(timer->Start(10, [&, partner]() {
+            called++;
+            EXPECT_TRUE(timer->Cancel(ids[partner]));
+        }));
+    }
+    int fired = timer->Update(Clock::CurrentTimeMillis() + 100);
+    EXPECT_EQ(fired, count / 2);
+    EXPECT_EQ(called, count / 2);
+    EXPECT_EQ(timer->Size(), 0);
+}
+
+// canceled timers linger until surfacing or compaction, but never fire
+template <typename T>
+static void TestTimerLazyCancel(T& timer) {
+    std::vector<int> ids;
+    int called = 0;
+    int64_t now = Clock::CurrentTimeMillis();
+    for (int i = 0; i < N1; i++) {
+        ids.push_back(timer.Start(1000 + i * TIME_DELTA, [&called]() {
+            called++;
+        }));
+    }
+    for (int i = 0; i < N1; i += 4) {
+        EXPECT_TRUE(timer.Cancel(ids[i]));
+        EXPECT_FALSE(timer.Cancel(ids[i]));
+    }
+    EXPECT_EQ(timer.DeadCount(), N1 / 4);
+    EXPECT_EQ(timer.Size(), N1 - N1 / 4);
+
+    // stale entries are discarded as they surface
+    EXPECT_EQ(timer.Update(now + 1000 + (N1 / 2) * TIME_DELTA - TIME_DELTA / 2), N1 / 2 - N1 / 8);
+    EXPECT_EQ(timer.DeadCount(), N1 / 8);
+
+    // compaction once stale entries outnumber pending ones
+    for (int i = N1 / 2; i < N1; i++) {
+        timer.Cancel(ids[i]);
+    }
+    EXPECT_EQ(timer.DeadCount(), 0);
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_EQ(timer.Update(now + 1000 + N1 * TIME_DELTA), 0);
+    EXPECT_EQ(called, N1 / 2 - N1 / 8);
+
+    // a lingering canceled timer releases its captures at once
+    int keeper = timer.Start(5000, nullptr);
+    std::shared_ptr<int> session = std::make_shared<int>(0);
+    int id = timer.Start(1000, [session]() {});
+    EXPECT_EQ(session.use_count(), 2);
+    EXPECT_TRUE(timer.Cancel(id));
+    EXPECT_EQ(timer.DeadCount(), 1);
+    EXPECT_EQ(session.use_count(), 1);
+    EXPECT_TRUE(timer.Cancel(keeper));
+}
+
+// due timers are drained in deadline order through a small buffer,
+// carried over timers can still be canceled
+static void TestTimerPollExpired(TimerBase* timer, int count) {
+    std::vector<int> ids;
+    std::vector<int64_t> earliest;  // deadline is within [earliest, latest]
+    std::vector<int64_t> latest;
+    for (int i = 0; i < count; i++) {
+        uint32_t duration = rand() % 50;
+        earliest.push_back(Clock::CurrentTimeMillis() + duration);
+        ids.push_back(timer->StartPoll(duration, (uint64_t)i));
+        latest.push_back(Clock::CurrentTimeMillis() + duration);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    int64_t now = Clock::CurrentTimeMillis();
+
+    ExpiredEntry out[7];
+    std::vector<bool> polled(count);
+    int canceled = -1;
+    int total = 0;
+    int64_t last = 0;
+    while (true) {
+        int n = timer->PollExpired(now, out, 7);
+        if (n == 0) {
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int k = (int)out[i].cookie;
+            ASSERT_LT(k, count);
+            EXPECT_EQ(out[i].id, ids[k]);
+            EXPECT_FALSE(polled[k]);
+            EXPECT_NE(k, canceled);
+            EXPECT_LE(last, latest[k]);
+            last = std::max(last, earliest[k]);
+            polled[k] = true;
+            total++;
+        }
+        if (canceled < 0 && timer->ExpiredBacklog() > 0) {
+            for (int k = count - 1; k >= 0; k--) {
+                if (!polled[k] && timer->Cancel(ids[k])) {
+                    canceled = k;
+                    break;
+                }
+            }
+            EXPECT_GE(canceled, 0);
+        }
+    }
+    EXPECT_EQ(total, count - 1);
+    EXPECT_EQ(timer->ExpiredBacklog(), 0);
+    EXPECT_EQ(timer->Size(), 0);
+}
+
+TEST(TimerBase, PollExpired) {
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        TestTimerPollExpired(timer.get(), N1);
+        printf("timer type %d polled in deadline order\n", type);
+    }
+}
+
+TEST(TimerBase, PollExpiredReentrant) {
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        ExpiredEntry out[4];
+        int called = 0;
+        int polled = -1;
+        timer->Start(0, [&]() {
+            polled = timer->PollExpired(Clock::CurrentTimeMillis(), out, 4);
+            called++;
+        });
+        timer->Start(0, [&]() { called++; });
+        timer->Start(0, [&]() { called++; });
+        int64_t end = Clock::CurrentTimeMillis() + 1000;
+        while (called < 3 && Clock::CurrentTimeMillis() < end) {
+            timer->Update(Clock::CurrentTimeMillis() + 1);
+        }
+        EXPECT_EQ(polled, 0);
+        EXPECT_EQ(called, 3);
+        EXPECT_EQ(timer->Size(), 0);
+    }
+}
+
+// a backlog is fired over many bounded updates in deadline order
+static void TestTimerBoundedUpdate(TimerBase* timer, int count) {
+    std::vector<int64_t> earliest;  // deadline is within [earliest, latest]
+    std::vector<int64_t> latest;
+    std::vector<int> fired;
+    for (int i = 0; i < count; i++) {
+        uint32_t duration = rand() % 50;
+        earliest.push_back(Clock::CurrentTimeMillis() + duration);
+        timer->Start(duration, [&fired, i]() {
+            fired.push_back(i);
+        });
+        latest.push_back(Clock::CurrentTimeMillis() + duration);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    int64_t now = Clock::CurrentTimeMillis();
+
+    UpdateBudget budget;
+    budget.max_fired = 7;
+    int calls = 0;
+    while (true) {
+        UpdateResult result = timer->Update(now, budget);
+        EXPECT_LE(result.fired, budget.max_fired);
+        EXPECT_EQ(result.backlog, timer->ExpiredBacklog());
+        calls++;
+        if (result.fired == 0 && !result.stopped) {
+            break;
+        }
+    }
+    EXPECT_GE(calls, count / budget.max_fired);
+    ASSERT_EQ((int)fired.size(), count);
+    int64_t last = 0;
+    for (int k : fired) {
+        EXPECT_LE(last, latest[k]);
+        last = std::max(last, earliest[k]);
+    }
+    EXPECT_EQ(timer->Size(), 0);
+
+    // time budget only
+    budget.max_fired = INT_MAX;
+    budget.max_ns = 1000000;
+    UpdateResult result = timer->Update(Clock::CurrentTimeMillis() + 10000, budget);
+    EXPECT_EQ(result.fired, 0);
+    EXPECT_EQ(result.backlog, 0);
+}
+
+TEST(TimerBase, BoundedUpdate) {
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        TestTimerBoundedUpdate(timer.get(), N1);
+        printf("timer type %d fired by bounded update\n", type);
+    }
+}
+
+static void TestTimerSlack(TimerBase* timer, int count) {
+    const uint32_t slack = 16;
+    // hashed wheel expires a whole 100ms bucket per tick, it may fire early
+    int64_t early = timer->Type() == TimerSchedType::TIMER_HASHED_WHEEL ? 100 : 0;
+    std::vector<int64_t> fired_at;
+    int64_t first = Clock::CurrentTimeMillis();
+    for (int i = 0; i < count; i++) {
+        uint32_t duration = rand() % 50;
+        int64_t deadline = Clock::CurrentTimeMillis() + duration;
+        timer->Start(duration, [&fired_at, deadline, early]() {
+            int64_t now = Clock::CurrentTimeMillis();
+            EXPECT_GE(now + early, deadline);
+            fired_at.push_back(now);
+        }, slack);
+    }
+    int64_t last = Clock::CurrentTimeMillis();
+    // every deadline is a multiple of 16 within [first + 1, last + 49 + 16]
+    int boundaries = (int)((last + 49 + slack) / slack - first / slack);
+    int wakeups = 0;
+    int64_t end = Clock::CurrentTimeMillis() + 100;
+    while (Clock::CurrentTimeMillis() < end) {
+        if (timer->Update(Clock::CurrentTimeMillis()) > 0) {
+            wakeups++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ((int)fired_at.size(), count);
+    EXPECT_LE(wakeups, boundaries);
+    EXPECT_EQ(timer->Size(), 0);
+}
+
+TEST(TimerBase, AlignDeadline) {
+    EXPECT_EQ(TimerBase::AlignDeadline(1001, 0), 1001);
+    EXPECT_EQ(TimerBase::AlignDeadline(1001, 1), 1002);
+    EXPECT_EQ(TimerBase::AlignDeadline(1001, 16), 1008);
+    EXPECT_EQ(TimerBase::AlignDeadline(1001, 50), 1024);
+    for (int64_t deadline = 1000; deadline < 1100; deadline++) {
+        for (uint32_t slack = 1; slack <= 64; slack++) {
+            int64_t aligned = TimerBase::AlignDeadline(deadline, slack);
+            EXPECT_GE(aligned, deadline);
+            EXPECT_LE(aligned, deadline + slack);
+        }
+    }
+}
+
+TEST(TimerBase, Slack) {
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        TestTimerSlack(timer.get(), N1);
+        printf("timer type %d fired with slack\n", type);
+    }
+}
+
+// the slack overload of `TimerBase` is not hidden by `Start` of a concrete type
+template <typename T>
+static void TestSlackOnConcrete() {
+    T timer;
+    int id = timer.Start(10, []() {}, 16);
+    EXPECT_GT(id, 0);
+    EXPECT_EQ(timer.Size(), 1);
+    EXPECT_TRUE(timer.Cancel(id));
+}
+
+TEST(TimerBase, SlackOnConcreteType) {
+    TestSlackOnConcrete<PriorityQueueTimer>();
+    TestSlackOnConcrete<QuadHeapTimer>();
+    TestSlackOnConcrete<RBTreeTimer>();
+    TestSlackOnConcrete<HashedWheelTimer>();
+    TestSlackOnConcrete<HHWheelTimer>();
+    TestSlackOnConcrete<IntrusiveRBTreeTimer>();
+    TestSlackOnConcrete<DAryHeapTimer<4>>();
+    TestSlackOnConcrete<CoalescedHeapTimer>();
+    TestSlackOnConcrete<DurationQueueTimer>();
+    TestSlackOnConcrete<HybridWheelTimer>();
+    TestSlackOnConcrete<AdaptiveTimer>();
+    TestSlackOnConcrete<BufferedHeapTimer>();
+    TestSlackOnConcrete<PrecisionTimer>();
+    TestSlackOnConcrete<CommandQueueTimer>();
+    TestSlackOnConcrete<ConcurrentHashedWheelTimer>();
+}
+
+// the bounded `Update` of `TimerBase` is not hidden by `Update` of a concrete type
+template <typename T>
+static void TestBoundedUpdateOnConcrete() {
+    T timer;
+    int fired = 0;
+    for (int i = 0; i < 3; i++) {
+        timer.Start(0, [&fired]() { fired++; });
+    }
+    UpdateBudget budget;
+    budget.max_fired = 2;
+    UpdateResult result = timer.Update(Clock::CurrentTimeMillis() + 1000, budget);
+    EXPECT_EQ(result.fired, 2);
+    EXPECT_TRUE(result.stopped);
+    result = timer.Update(Clock::CurrentTimeMillis() + 1000, budget);
+    EXPECT_EQ(result.fired, 1);
+    EXPECT_EQ(fired, 3);
+}
+
+TEST(TimerBase, BoundedUpdateOnConcreteType) {
+    TestBoundedUpdateOnConcrete<PriorityQueueTimer>();
+    TestBoundedUpdateOnConcrete<QuadHeapTimer>();
+    TestBoundedUpdateOnConcrete<RBTreeTimer>();
+    TestBoundedUpdateOnConcrete<HashedWheelTimer>();
+    TestBoundedUpdateOnConcrete<HHWheelTimer>();
+    TestBoundedUpdateOnConcrete<IntrusiveRBTreeTimer>();
+    TestBoundedUpdateOnConcrete<DAryHeapTimer<4>>();
+    TestBoundedUpdateOnConcrete<CoalescedHeapTimer>();
+    TestBoundedUpdateOnConcrete<DurationQueueTimer>();
+    TestBoundedUpdateOnConcrete<HybridWheelTimer>();
+    TestBoundedUpdateOnConcrete<AdaptiveTimer>();
+    TestBoundedUpdateOnConcrete<BufferedHeapTimer>();
+    TestBoundedUpdateOnConcrete<PrecisionTimer>();
+    TestBoundedUpdateOnConcrete<CommandQueueTimer>();
+    TestBoundedUpdateOnConcrete<ConcurrentHashedWheelTimer>();
+}
+
 TEST(TimerPriorityQueue, TimerAdd) {
     auto timer = CreateTimer(TimerSchedType::TIMER_PRIORITY_QUEUE);
     TestTimerAdd(timer.get(), N1);
@@ -182,6 +521,19 @@ TEST(TimerPriorityQueue, TimerExpireFIFO) {
     TestTimerExpireFIFO(timer.get());
 }
 
+TEST(TimerPriorityQueue, CancelInBatch) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_PRIORITY_QUEUE);
+    TestTimerCancelInBatch(timer.get(), N1);
+}
+
+TEST(TimerPriorityQueue, LazyCancel) {
+    PriorityQueueTimer timer(true);
+    TestTimerLazyCancel(timer);
+
+    PriorityQueueTimer batch(true);
+    TestTimerCancelInBatch(&batch, N1);
+}
+
 ///////////////////////////////////////////////////////////////////
 
 
@@ -206,6 +558,37 @@ TEST(TimerQuadHeap, TimerExpireFIFO) {
     TestTimerExpireFIFO(timer.get());
 }
 
+TEST(TimerQuadHeap, CancelInBatch) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_QUAD_HEAP);
+    TestTimerCancelInBatch(timer.get(), N1);
+}
+
+// tombstones are dropped once dead fraction exceeds the ratio
+TEST(TimerQuadHeap, Compaction) {
+    QuadHeapTimer timer(0.5);
+    std::vector<int> ids;
+    int called = 0;
+    for (int i = 0; i < N1; i++) {
+        ids.push_back(timer.Start(1000 + rand() % 1000, [&called]() {
+            called++;
+        }));
+    }
+    for (int i = 0; i < N1 / 2; i++) {
+        EXPECT_TRUE(timer.Cancel(ids[i]));
+    }
+    EXPECT_EQ(timer.DeadCount(), N1 / 2);
+    EXPECT_EQ(timer.LiveCount(), N1 / 2);
+    EXPECT_EQ(timer.Size(), N1 / 2);
+
+    EXPECT_TRUE(timer.Cancel(ids[N1 / 2]));
+    EXPECT_EQ(timer.DeadCount(), 0);
+    EXPECT_EQ(timer.LiveCount(), N1 / 2 - 1);
+
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis() + 5000), N1 / 2 - 1);
+    EXPECT_EQ(called, N1 / 2 - 1);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
 
 /////////////////////////////////////////////////////////////////
 
@@ -230,6 +613,19 @@ TEST(TimerRBTree, TimerExpireFIFO) {
     TestTimerExpireFIFO(timer.get());
 }
 
+TEST(TimerRBTree, CancelInBatch) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_RBTREE);
+    TestTimerCancelInBatch(timer.get(), N1);
+}
+
+TEST(TimerRBTree, LazyCancel) {
+    RBTreeTimer timer(true);
+    TestTimerLazyCancel(timer);
+
+    RBTreeTimer fifo(true);
+    TestTimerExpireFIFO(&fifo);
+}
+
 
 /////////////////////////////////////////////////////////////////
 
@@ -277,3 +673,1306 @@ TEST(TimerHHWheel, TimerExpireFIFO) {
     auto timer = CreateTimer(TimerSchedType::TIMER_HH_WHEEL);
     TestTimerExpireFIFO(timer.get());
 }
+
+TEST(TimerHHWheel, CancelInBatch) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_HH_WHEEL);
+    TestTimerCancelInBatch(timer.get(), N1);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerIntrusiveRBTree, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_INTRUSIVE_RBTREE);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerIntrusiveRBTree, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_INTRUSIVE_RBTREE);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerIntrusiveRBTree, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_INTRUSIVE_RBTREE);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerIntrusiveRBTree, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_INTRUSIVE_RBTREE);
+    TestTimerExpireFIFO(timer.get());
+}
+
+TEST(TimerIntrusiveRBTree, ScheduleEntry) {
+    IntrusiveRBTreeTimer timer;
+    std::vector<RBTimerEntry> entries(N1);
+    int called = 0;
+    for (int i = 0; i < N1; i++) {
+        entries[i].action = [&]() {
+            called++;
+        };
+        timer.Schedule(&entries[i], i % 10);
+    }
+    EXPECT_EQ(timer.Size(), N1);
+    for (int i = 0; i < N1; i += 2) {
+        EXPECT_TRUE(timer.Unschedule(&entries[i]));
+    }
+    EXPECT_FALSE(timer.Unschedule(&entries[0]));
+    EXPECT_EQ(timer.Size(), N1 / 2);
+
+    int fired = timer.Update(Clock::CurrentTimeMillis() + 10);
+    EXPECT_EQ(fired, N1 / 2);
+    EXPECT_EQ(called, N1 / 2);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerDAryHeap, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DARY_HEAP);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerDAryHeap, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DARY_HEAP);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerDAryHeap, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DARY_HEAP);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerDAryHeap, CancelInBatch) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DARY_HEAP);
+    TestTimerCancelInBatch(timer.get(), N1);
+}
+
+// grouped by callable type only within same deadline
+TEST(TimerDAryHeap, DispatchGrouping) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DARY_HEAP);
+    timer->SetDispatchGrouping(true);
+    std::vector<int> order;
+    for (int i = 0; i < N1; i++) {
+        uint32_t duration = (i / 100) * TIME_DELTA;
+        if (i % 2 == 0) {
+            timer->Start(duration, [&order, i]() {
+                order.push_back(i);
+            });
+        } else {
+            timer->Start(duration, std::bind([&order](int n) {
+                order.push_back(n);
+            }, i));
+        }
+    }
+    EXPECT_EQ(timer->Update(Clock::CurrentTimeMillis() + N1), N1);
+    ASSERT_EQ((int)order.size(), N1);
+    int switches = 0;
+    for (int i = 1; i < N1; i++) {
+        EXPECT_LE(order[i - 1] / 100, order[i] / 100);
+        if (order[i] % 2 != order[i - 1] % 2) {
+            switches++;
+        } else {
+            EXPECT_LT(order[i - 1], order[i]); // stable in group
+        }
+    }
+    EXPECT_LT(switches, N1 / 20);
+}
+
+TEST(TimerDAryHeap, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DARY_HEAP);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// heap order holds for every arity after random cancellation
+template <int D>
+static void TestDAryHeapOrder() {
+    DAryHeapTimer<D> timer;
+    std::vector<int> ids;
+    int fired = 0;
+    for (int i = 0; i < N1; i++) {
+        int id = timer.Start(rand() % 100, [&]() {
+            fired++;
+        });
+        ids.push_back(id);
+    }
+    for (int i = 0; i < N1; i += 3) {
+        EXPECT_TRUE(timer.Cancel(ids[i]));
+    }
+    int64_t last = 0;
+    while (timer.Size() > 0) {
+        int64_t deadline = timer.NextDeadline();
+        EXPECT_GE(deadline, last);
+        last = deadline;
+        EXPECT_GT(timer.Update(deadline), 0);
+    }
+    EXPECT_EQ(fired, N1 - (N1 + 2) / 3);
+}
+
+TEST(TimerDAryHeap, HeapOrder) {
+    TestDAryHeapOrder<2>();
+    TestDAryHeapOrder<4>();
+    TestDAryHeapOrder<8>();
+    TestDAryHeapOrder<16>();
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerCoalescedHeap, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COALESCED_HEAP);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerCoalescedHeap, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COALESCED_HEAP);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerCoalescedHeap, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COALESCED_HEAP);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerCoalescedHeap, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COALESCED_HEAP);
+    TestTimerExpireFIFO(timer.get());
+}
+
+TEST(TimerCoalescedHeap, BucketCount) {
+    CoalescedHeapTimer timer;
+    std::vector<int> ids;
+    int64_t first = Clock::CurrentTimeMillis();
+    for (int i = 0; i < N1; i++) {
+        ids.push_back(timer.Start(1000 * (i % 3 + 1), nullptr));
+    }
+    int64_t last = Clock::CurrentTimeMillis();
+    EXPECT_EQ(timer.Size(), N1);
+    EXPECT_LE(timer.BucketCount(), 3 * (last - first + 1)); // 3 deadlines per ms started in
+    for (int id : ids) {
+        EXPECT_TRUE(timer.Cancel(id));
+    }
+    EXPECT_EQ(timer.BucketCount(), 0);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerDurationQueue, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DURATION_QUEUE);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerDurationQueue, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DURATION_QUEUE);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerDurationQueue, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DURATION_QUEUE);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerDurationQueue, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_DURATION_QUEUE);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// timers of the same duration expire in FIFO order, whether hot or not
+TEST(TimerDurationQueue, MixedDurations) {
+    DurationQueueTimer timer;
+    timer.RegisterDuration(50);
+    std::map<uint32_t, std::vector<int>> expired;
+    std::vector<int> ids;
+    for (int i = 0; i < N1; i++) {
+        uint32_t duration = (i % 4 == 0) ? (rand() % 100) : (i % 2 == 0 ? 50 : 20);
+        int id = timer.Start(duration, [&expired, &ids, duration, i]() {
+            expired[duration].push_back(ids[i]);
+        });
+        ids.push_back(id);
+    }
+    EXPECT_GE(timer.QueueCount(), 2); // 50 is registered, 20 is detected
+    EXPECT_EQ(timer.Size(), N1);
+    int canceled = 0;
+    for (int i = 0; i < N1; i += 7) {
+        EXPECT_TRUE(timer.Cancel(ids[i]));
+        canceled++;
+    }
+    int fired = timer.Update(Clock::CurrentTimeMillis() + 1000);
+    EXPECT_EQ(fired, N1 - canceled);
+    EXPECT_EQ(timer.Size(), 0);
+    for (auto& kv : expired) {
+        EXPECT_TRUE(std::is_sorted(kv.second.begin(), kv.second.end()));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerHybridWheel, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_HYBRID_WHEEL);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerHybridWheel, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_HYBRID_WHEEL);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerHybridWheel, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_HYBRID_WHEEL);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerHybridWheel, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_HYBRID_WHEEL);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// far timers migrate into wheel and expire in deadline order
+TEST(TimerHybridWheel, Migrate) {
+    HybridWheelTimer timer;
+    std::vector<int> expired;
+    std::vector<int> ids;
+    for (int i = 0; i < N1; i++) {
+        uint32_t duration = (i % 2 == 0) ? (rand() % 10) * 100 : 20000 + (rand() % 1000) * 100;
+        int id = timer.Start(duration, [&expired, duration]() {
+            expired.push_back((int)duration);
+        });
+        ids.push_back(id);
+    }
+    EXPECT_EQ(timer.WheelSize(), N1 / 2);
+    EXPECT_EQ(timer.HeapSize(), N1 / 2);
+    int canceled = 0;
+    for (int i = 0; i < N1; i += 5) {
+        EXPECT_TRUE(timer.Cancel(ids[i]));
+        canceled++;
+    }
+    EXPECT_EQ(timer.Size(), N1 - canceled);
+
+    int64_t now = Clock::CurrentTimeMillis();
+    int fired = timer.Update(now + 1000);
+    EXPECT_EQ(timer.HeapSize() + timer.WheelSize(), timer.Size());
+    fired += timer.Update(now + 30000);
+    fired += timer.Update(now + 200000);
+    EXPECT_EQ(fired, N1 - canceled);
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_TRUE(std::is_sorted(expired.begin(), expired.end()));
+}
+
+// an overdue timer expires ahead of later timers in the cursor slot
+TEST(TimerHybridWheel, OverdueOrder) {
+    HybridWheelTimer timer;
+    int64_t now = Clock::CurrentTimeMillis();
+    timer.Update(now + 100);
+    std::vector<int> fired;
+    timer.Start(101, [&fired]() {
+        fired.push_back(101);
+    });
+    timer.Start(10, [&fired]() {
+        fired.push_back(10);
+    });
+    EXPECT_EQ(timer.Update(now + 2000), 2);
+    ASSERT_EQ((int)fired.size(), 2);
+    EXPECT_EQ(fired[0], 10);
+    EXPECT_EQ(fired[1], 101);
+}
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerAdaptive, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_ADAPTIVE);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerAdaptive, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_ADAPTIVE);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerAdaptive, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_ADAPTIVE);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerAdaptive, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_ADAPTIVE);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// many short scattered timers make heap switch to wheel, ids survive migration
+TEST(TimerAdaptive, SwitchBackend) {
+    AdaptiveTimer timer(TimerSchedType::TIMER_DARY_HEAP);
+    int called = 0;
+    int fired = 0;
+    std::vector<int> ids;
+    for (int i = 0; i < 5000; i++) {
+        Clock::TimeFly(1);
+        fired += timer.Update(Clock::CurrentTimeMillis());
+        for (int j = 0; j < 10; j++) {
+            ids.push_back(timer.Start(rand() % 2000, [&called]() {
+                called++;
+            }));
+        }
+    }
+    ASSERT_GE(timer.DecisionLog().size(), 1);
+    EXPECT_EQ(timer.DecisionLog()[0].from, TimerSchedType::TIMER_DARY_HEAP);
+    EXPECT_EQ(timer.DecisionLog()[0].to, TimerSchedType::TIMER_HYBRID_WHEEL);
+    EXPECT_EQ(timer.ActiveType(), TimerSchedType::TIMER_HYBRID_WHEEL);
+    EXPECT_EQ(fired, called);
+
+    int canceled = 0;
+    for (int id : ids) {
+        if (timer.Cancel(id)) {
+            canceled++;
+        }
+    }
+    EXPECT_EQ(fired + canceled, (int)ids.size());
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis() + 5000), 0);
+    EXPECT_EQ(called, fired);
+    Clock::TimeReset();
+}
+
+///////////////////////////////////////////////////////////////////////
+
+TEST(TimerBufferedHeap, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_BUFFERED_HEAP);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerBufferedHeap, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_BUFFERED_HEAP);
+    TestTimerDel(timer.get(), N1);
+}
+
+
+TEST(TimerBufferedHeap, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_BUFFERED_HEAP);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerBufferedHeap, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_BUFFERED_HEAP);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// timers are merged from buffer when due or buffer is full
+TEST(TimerBufferedHeap, BufferMerge) {
+    BufferedHeapTimer timer(256);
+    std::vector<int> expired;
+    std::vector<int> ids;
+    for (int i = 0; i < 200; i++) {
+        uint32_t duration = 1000 + (rand() % 100) * 100;
+        ids.push_back(timer.Start(duration, [&expired, duration]() {
+            expired.push_back((int)duration);
+        }));
+    }
+    EXPECT_EQ(timer.BufferSize(), 200);
+    for (int i = 0; i < 200; i += 2) {
+        EXPECT_TRUE(timer.Cancel(ids[i]));
+    }
+    EXPECT_EQ(timer.BufferSize(), 100);
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis()), 0);
+    EXPECT_EQ(timer.BufferSize(), 100); // nothing due, no merge
+
+    for (int i = 0; i < 156; i++) {
+        uint32_t duration = 1000 + (rand() % 100) * 100;
+        timer.Start(duration, [&expired, duration]() {
+            expired.push_back((int)duration);
+        });
+    }
+    EXPECT_EQ(timer.BufferSize(), 0); // merged at threshold
+    timer.Start(0, nullptr);
+    EXPECT_EQ(timer.BufferSize(), 1);
+    EXPECT_EQ(timer.Size(), 257);
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis() + 20000), 257);
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_TRUE(std::is_sorted(expired.begin(), expired.end()));
+}
+
+TEST(TimerPrecision, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_PRECISION);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerPrecision, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_PRECISION);
+    TestTimerDel(timer.get(), N1);
+}
+
+TEST(TimerPrecision, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_PRECISION);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerPrecision, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_PRECISION);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// coarse timers never fire early, and at most one granularity late
+TEST(TimerPrecision, CoarseWheel) {
+    PrecisionTimer timer;
+    int64_t start = Clock::CurrentTimeMillis();
+    int64_t now = start;
+    int fired = 0;
+    std::vector<int> ids;
+    for (int i = 0; i < 300; i++) {
+        Precision precision = (Precision)(i % 3);
+        int64_t late = precision == Precision::Coarse100ms ? 100 : (precision == Precision::Coarse1s ? 1000 : 0);
+        uint32_t duration = rand() % 5000;
+        if (i % 10 == 1) {
+            duration += 200000; // beyond horizon of 100ms wheel
+        }
+        int64_t deadline = Clock::CurrentTimeMillis() + duration;
+        ids.push_back(timer.Start(duration, [&fired, &now, deadline, late]() {
+            EXPECT_GE(now, deadline);
+            EXPECT_LE(now, deadline + late + 10); // plus update step
+            fired++;
+        }, precision));
+    }
+    EXPECT_EQ(timer.Size(), 300);
+    EXPECT_EQ(timer.CoarseSize(), 200);
+    EXPECT_TRUE(timer.Cancel(ids[1]));
+    EXPECT_TRUE(timer.Cancel(ids[2]));
+    EXPECT_FALSE(timer.Cancel(ids[1]));
+    EXPECT_EQ(timer.CoarseSize(), 198);
+
+    for (; now < start + 210000; now += 10) {
+        timer.Update(now);
+    }
+    EXPECT_EQ(fired, 298);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+// timers of both coarse wheels and of one slot, collected in one update, fire in deadline order
+TEST(TimerPrecision, CoarseOrder) {
+    PrecisionTimer timer;
+    const uint32_t durations[] = {10, 20, 50, 40};
+    const Precision precisions[] = {Precision::Coarse1s, Precision::Coarse100ms,
+        Precision::Coarse100ms, Precision::Coarse100ms};
+    std::vector<int64_t> earliest;
+    std::vector<int64_t> latest;
+    std::vector<int> fired;
+    for (int i = 0; i < 4; i++) {
+        earliest.push_back(Clock::CurrentTimeMillis() + durations[i]);
+        timer.Start(durations[i], [&fired, i]() {
+            fired.push_back(i);
+        }, precisions[i]);
+        latest.push_back(Clock::CurrentTimeMillis() + durations[i]);
+    }
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis() + 2000), 4);
+    ASSERT_EQ((int)fired.size(), 4);
+    int64_t last = 0;
+    for (int k : fired) {
+        EXPECT_LE(last, latest[k]);
+        last = std::max(last, earliest[k]);
+    }
+}
+
+TEST(TimerCommandQueue, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COMMAND_QUEUE);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerCommandQueue, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COMMAND_QUEUE);
+    TestTimerDel(timer.get(), N1);
+}
+
+TEST(TimerCommandQueue, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COMMAND_QUEUE);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerCommandQueue, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_COMMAND_QUEUE);
+    TestTimerExpireFIFO(timer.get());
+}
+
+// producers start and cancel timers while owner thread updates
+TEST(TimerCommandQueue, MultiProducer) {
+    const int Producers = 4;
+    const int Count = 2000;
+    CommandQueueTimer timer(256); // small ring to exercise backpressure
+    std::atomic<int> fired(0);
+    std::atomic<int> done(0);
+    std::vector<std::thread> producers;
+    for (int i = 0; i < Producers; i++) {
+        producers.emplace_back([&timer, &fired, &done]() {
+            for (int j = 0; j < Count; j++) {
+                uint32_t duration = j % 2 == 1 ? 60000 : j % 20; // odd ones are canceled
+                int id = timer.Start(duration, [&fired]() {
+                    fired++;
+                });
+                EXPECT_GE(timer.NextDeadline(), 0);
+                if (j % 2 == 1) {
+                    timer.Cancel(id);
+                }
+            }
+            done++;
+        });
+    }
+    int64_t end = Clock::CurrentTimeMillis() + 5000;
+    while ((done < Producers || timer.Size() > 0 || timer.NextDeadline() >= 0) &&
+        Clock::CurrentTimeMillis() < end) {
+        timer.Update(Clock::CurrentTimeMillis());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    EXPECT_EQ(fired, Producers * Count / 2);
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_EQ(timer.NextDeadline(), -1);
+}
+
+TEST(TimerConcurrentHashedWheel, TimerAdd) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL);
+    TestTimerAdd(timer.get(), N1);
+}
+
+TEST(TimerConcurrentHashedWheel, TimerDel) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL);
+    TestTimerDel(timer.get(), N1);
+}
+
+TEST(TimerConcurrentHashedWheel, TimerExecute) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL);
+    TestTimerExpire(timer.get(), N1);
+}
+
+TEST(TimerConcurrentHashedWheel, TimerExpireFIFO) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL);
+    TestTimerExpireFIFO(timer.get());
+}
+
+TEST(TimerConcurrentHashedWheel, CancelInBatch) {
+    auto timer = CreateTimer(TimerSchedType::TIMER_CONCURRENT_HASHED_WHEEL);
+    TestTimerCancelInBatch(timer.get(), N1);
+}
+
+// producers start and cancel while ticker fires, with a small arena so slots are reused,
+// each producer waits for a few ticks between batches so the arena is never full
+TEST(TimerConcurrentHashedWheel, MultiProducer) {
+    const int Producers = 4;
+    const int Count = 5000;
+    const int Batch = 100;
+    ConcurrentHashedWheelTimer timer(1024);
+    std::atomic<int> fired(0);
+    std::atomic<int> canceled(0);
+    std::atomic<int> done(0);
+    std::atomic<int> ticks(0);
+    std::vector<std::thread> producers;
+    for (int i = 0; i < Producers; i++) {
+        producers.emplace_back([&]() {
+            for (int j = 0; j < Count; j++) {
+                if (j % Batch == 0) {
+                    int wait_until = ticks + 7; // timers of last batch fired or reaped
+                    while (ticks < wait_until) {
+                        std::this_thread::yield();
+                    }
+                }
+                int id = timer.Start(j % 5, [&fired]() {
+                    fired++;
+                });
+                if (j % 2 == 1) {
+                    if (timer.Cancel(id)) {
+                        canceled++;
+                    }
+                    EXPECT_FALSE(timer.Cancel(id)); // never twice
+                }
+            }
+            done++;
+        });
+    }
+    int64_t end = Clock::CurrentTimeMillis() + 10000;
+    while ((done < Producers || timer.Size() > 0) && Clock::CurrentTimeMillis() < end) {
+        timer.Update(Clock::CurrentTimeMillis());
+        ticks++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    timer.Update(Clock::CurrentTimeMillis() + 10);
+    EXPECT_EQ(fired + canceled, Producers * Count);
+    EXPECT_GE(canceled, 1);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+// a full arena fails the start with id 0 instead of blocking the caller
+TEST(TimerConcurrentHashedWheel, ArenaFull) {
+    ConcurrentHashedWheelTimer timer(4);
+    int fired = 0;
+    std::vector<int> ids;
+    for (int i = 0; i < 4; i++) {
+        ids.push_back(timer.Start(0, [&fired]() { fired++; }));
+        EXPECT_GT(ids.back(), 0);
+    }
+    EXPECT_EQ(timer.Start(0, [&fired]() { fired++; }), 0);
+    EXPECT_EQ(timer.StartPoll(0, 1), 0);
+    EXPECT_FALSE(timer.Cancel(0));
+    EXPECT_EQ(timer.Size(), 4);
+
+    // slots are usable again once fired or reaped
+    EXPECT_TRUE(timer.Cancel(ids[0]));
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis() + 10), 3);
+    EXPECT_EQ(fired, 3);
+    EXPECT_GT(timer.Start(0, nullptr), 0);
+    EXPECT_EQ(timer.Size(), 1);
+}
+
+// a stale id never cancels a live timer, however often other timers come and go
+TEST(TimerConcurrentHashedWheel, StaleIdAfterReuse) {
+    ConcurrentHashedWheelTimer timer;
+    int64_t now = Clock::CurrentTimeMillis();
+    int stale = timer.Start(0, []() {});
+    timer.Update(now);
+    int fired = 0;
+    for (int i = 0; i < 4096; i++) {
+        int id = timer.Start(0, [&fired]() {
+            fired++;
+        });
+        EXPECT_FALSE(timer.Cancel(stale));
+        if (i % 2 == 0) {
+            EXPECT_TRUE(timer.Cancel(id));
+        }
+        now++;
+        timer.Update(now);
+    }
+    EXPECT_EQ(fired, 2048);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+// callbacks run on the shard encoded in id, cross-shard cancel is routed to owner
+TEST(ShardedTimerService, RouteById) {
+    const int Shards = 4;
+    const int Count = 200;
+    ShardedTimerService service(Shards, TimerSchedType::TIMER_HYBRID_WHEEL);
+    std::atomic<int> fired(0);
+    std::atomic<int> misrouted(0);
+    std::atomic<int> cross_fired(0);
+    for (int i = 0; i < Count; i++) {
+        int shard = i % Shards;
+        std::shared_ptr<int64_t> id = std::make_shared<int64_t>(0);
+        *id = service.StartOn(shard, i % 20, [&, id, shard]() {
+            if (service.CurrentShard() != shard || ShardedTimerService::ShardOf(*id) != shard) {
+                misrouted++;
+            }
+            // start a timer on next shard and cancel it at once
+            int64_t other = service.StartOn((shard + 1) % Shards, 50, [&cross_fired]() {
+                cross_fired++;
+            });
+            service.Cancel(other);
+            fired++;
+        });
+        EXPECT_EQ(ShardedTimerService::ShardOf(*id), shard);
+    }
+    service.Run();
+    int64_t end = Clock::CurrentTimeMillis() + 5000;
+    while (fired < Count && Clock::CurrentTimeMillis() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    service.Shutdown();
+    EXPECT_EQ(fired, Count);
+    EXPECT_EQ(misrouted, 0);
+    EXPECT_EQ(cross_fired, 0);
+    int64_t starts = 0, cancels = 0, fires = 0;
+    for (int i = 0; i < Shards; i++) {
+        ShardStats stats = service.Stats(i);
+        starts += stats.starts;
+        cancels += stats.cancels;
+        fires += stats.fires;
+    }
+    EXPECT_EQ(starts, Count * 2);
+    EXPECT_EQ(cancels, Count);
+    EXPECT_EQ(fires, Count);
+}
+
+TEST(StripedTimer, StartCancel) {
+    StripedTimer timer(4);
+    int fired = 0;
+    int64_t now = Clock::CurrentTimeMillis();
+    int64_t id1 = timer.Start(10, [&fired]() { fired++; });
+    int64_t id2 = timer.Start(20, [&fired]() { fired++; });
+    EXPECT_EQ(StripedTimer::StripeOf(id1), timer.CurrentStripe());
+    EXPECT_EQ(StripedTimer::StripeOf(id2), timer.CurrentStripe());
+    EXPECT_EQ(timer.Size(), 2);
+    EXPECT_GE(timer.NextDeadline(), now + 10);
+    EXPECT_LE(timer.NextDeadline(), Clock::CurrentTimeMillis() + 10);
+    EXPECT_TRUE(timer.Cancel(id1));
+    EXPECT_FALSE(timer.Cancel(id1));
+    EXPECT_EQ(timer.Size(), 1);
+    EXPECT_EQ(timer.Update(Clock::CurrentTimeMillis() + 30), 1);
+    EXPECT_EQ(fired, 1);
+    EXPECT_FALSE(timer.Cancel(id2));
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_EQ(timer.NextDeadline(), -1);
+}
+
+// every worker starts timers on its own stripe and fires whatever is due,
+// each timer fires exactly once, callbacks may re-arm.
+TEST(StripedTimer, SharedWorkers) {
+    const int Workers = 4;
+    const int Count = 2000;
+    StripedTimer timer(Workers);
+    std::atomic<int> fired(0);
+    std::atomic<int> canceled(0);
+    std::atomic<int> rearmed(0);
+    std::atomic<int> done(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < Workers; i++) {
+        workers.emplace_back([&]() {
+            for (int j = 0; j < Count; j++) {
+                int64_t id = timer.Start(j % 10, [&]() {
+                    if (fired++ % 100 == 0) {
+                        rearmed++;
+                        timer.Start(1, [&fired]() { fired++; });
+                    }
+                });
+                if (j % 3 == 0 && timer.Cancel(id)) {
+                    canceled++;
+                }
+                timer.Update(Clock::CurrentTimeMillis());
+            }
+            done++;
+            int64_t end = Clock::CurrentTimeMillis() + 5000;
+            while ((done < Workers || timer.Size() > 0) && Clock::CurrentTimeMillis() < end) {
+                timer.Update(Clock::CurrentTimeMillis());
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(timer.Size(), 0);
+    EXPECT_GE(canceled, 1);
+    EXPECT_EQ(fired + canceled, Workers * Count + rearmed);
+}
+
+TEST(GoTimerHeap, StartCancelReset) {
+    GoTimerHeap timer(2);
+    std::vector<int> fired;
+    int64_t id1 = timer.Start(10, [&fired]() { fired.push_back(1); });
+    int64_t id2 = timer.Start(20, [&fired]() { fired.push_back(2); });
+    int64_t id3 = timer.Start(30, [&fired]() { fired.push_back(3); });
+    EXPECT_EQ(timer.Size(), 3);
+    EXPECT_TRUE(timer.Reset(id1, 40));  // later
+    EXPECT_TRUE(timer.Reset(id3, 0));   // earlier
+    EXPECT_TRUE(timer.Cancel(id2));
+    EXPECT_FALSE(timer.Cancel(id2));
+    EXPECT_FALSE(timer.Reset(id2, 10));
+    EXPECT_EQ(timer.Size(), 2);
+
+    int64_t now = Clock::CurrentTimeMillis();
+    EXPECT_EQ(timer.Update(now), 1);
+    EXPECT_EQ(fired, std::vector<int>({3}));
+    EXPECT_EQ(timer.Update(now + 25), 0);
+    EXPECT_EQ(timer.Update(now + 50), 1);
+    EXPECT_EQ(fired, std::vector<int>({3, 1}));
+    EXPECT_FALSE(timer.Cancel(id1));
+    EXPECT_FALSE(timer.Reset(id3, 10));
+    EXPECT_EQ(timer.Size(), 0);
+
+    // a reused slot never matches a stale id
+    int64_t id4 = timer.Start(10, nullptr);
+    EXPECT_NE(id4, id1);
+    EXPECT_NE(id4, id2);
+    EXPECT_NE(id4, id3);
+    EXPECT_FALSE(timer.Cancel(id3));
+    EXPECT_TRUE(timer.Cancel(id4));
+}
+
+// a slot reused many more times than a 11-bit generation holds never matches a stale id
+TEST(GoTimerHeap, StaleIdAfterReuse) {
+    GoTimerHeap timer(1);
+    int64_t stale = timer.Start(0, nullptr);
+    EXPECT_TRUE(timer.Cancel(stale));
+    timer.Update(Clock::CurrentTimeMillis() + 1);
+    for (int i = 0; i < 4096; i++) {
+        int64_t id = timer.Start(0, nullptr);
+        EXPECT_FALSE(timer.Cancel(stale));
+        EXPECT_FALSE(timer.Reset(stale, 10));
+        EXPECT_TRUE(timer.Cancel(id));
+        timer.Update(Clock::CurrentTimeMillis() + 1); // free the slot
+    }
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+// owner threads run their heaps while other threads keep pushing timers later or cancel them,
+// an idle owner steals due timers of others.
+TEST(GoTimerHeap, CrossThreadModify) {
+    const int Owners = 2;
+    const int Count = 2000;
+    GoTimerHeap timer(Owners);
+    std::atomic<int> fired(0);
+    std::atomic<int> canceled(0);
+    std::vector<int64_t> ids;
+    std::thread starter([&]() {
+        for (int i = 0; i < Count; i++) {
+            ids.push_back(timer.Start(i % 50, [&fired]() { fired++; }));
+        }
+    });
+    starter.join();
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Owners; i++) {
+        threads.emplace_back([&]() {
+            while (!stop) {
+                timer.Update(Clock::CurrentTimeMillis());
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    threads.emplace_back([&]() {
+        for (int i = 0; i < Count; i++) {
+            if (i % 4 == 0 && timer.Cancel(ids[i])) {
+                canceled++;
+            } else {
+                timer.Reset(ids[i], 10 + i % 20);
+            }
+        }
+    });
+    int64_t end = Clock::CurrentTimeMillis() + 5000;
+    while (fired + canceled < Count && Clock::CurrentTimeMillis() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_GE(canceled, 1);
+    EXPECT_EQ(fired + canceled, Count);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+TEST(DelayQueue, TakeInOrder) {
+    DelayQueue<int> queue;
+    int64_t start = Clock::CurrentTimeMillis();
+    queue.Put(30, 3);
+    queue.Put(10, 1);
+    int id = queue.Put(20, 2);
+    queue.Put(10, 11);
+    EXPECT_TRUE(queue.Remove(id));
+    EXPECT_FALSE(queue.Remove(id));
+    EXPECT_EQ(queue.Size(), 3);
+    int item = 0;
+    EXPECT_FALSE(queue.Poll(item));
+    std::vector<int> taken;
+    while (queue.Size() > 0 && queue.Take(item)) {
+        taken.push_back(item);
+    }
+    EXPECT_EQ(taken, std::vector<int>({1, 11, 3}));
+    EXPECT_GE(Clock::CurrentTimeMillis() - start, 30);
+}
+
+TEST(DelayQueue, CloseWakesConsumers) {
+    DelayQueue<int> queue;
+    queue.Put(60000, 1);
+    std::atomic<int> returned(0);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 4; i++) {
+        consumers.emplace_back([&]() {
+            int item = 0;
+            EXPECT_FALSE(queue.Take(item));
+            returned++;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(returned, 0);
+    queue.Close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+    EXPECT_EQ(returned, 4);
+}
+
+// every item is taken once by some consumer and never before its deadline
+TEST(DelayQueue, LeaderFollower) {
+    const int Consumers = 8;
+    const int Count = 1000;
+    for (int mode = 0; mode <= 1; mode++) {
+        DelayQueue<int64_t> queue(mode == 1);
+        std::atomic<int> taken(0);
+        std::atomic<int> early(0);
+        std::vector<std::thread> consumers;
+        for (int i = 0; i < Consumers; i++) {
+            consumers.emplace_back([&]() {
+                int64_t deadline = 0;
+                while (queue.Take(deadline)) {
+                    if (Clock::CurrentTimeMillis() < deadline) {
+                        early++;
+                    }
+                    taken++;
+                }
+            });
+        }
+        for (int i = 0; i < Count; i++) {
+            uint32_t delay = rand() % 50;
+            queue.Put(delay, Clock::CurrentTimeMillis() + delay);
+        }
+        int64_t end = Clock::CurrentTimeMillis() + 5000;
+        while (taken < Count && Clock::CurrentTimeMillis() < end) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        queue.Close();
+        for (auto& consumer : consumers) {
+            consumer.join();
+        }
+        EXPECT_EQ(taken, Count);
+        EXPECT_EQ(early, 0);
+        EXPECT_EQ(queue.Size(), 0);
+        printf("delay queue mode %d: %d wakeups\n", mode, (int)queue.Wakeups());
+    }
+}
+
+// actions of one key run in order on one thread, others run anywhere
+TEST(TimerExecutor, KeyedOrder) {
+    const int Keys = 8;
+    const int Count = 4000;
+    TimerExecutor executor(4);
+    std::vector<std::vector<int>> seen(Keys);
+    std::vector<std::thread::id> threads(Keys);
+    std::atomic<int> misplaced(0);
+    std::atomic<int> unkeyed(0);
+    std::vector<TimeoutAction> batch;
+    for (int i = 0; i < Count; i++) {
+        int key = i % Keys;
+        batch.push_back(KeyedAction(key, [&, key, i]() {
+            if (seen[key].empty()) {
+                threads[key] = std::this_thread::get_id();
+            } else if (threads[key] != std::this_thread::get_id()) {
+                misplaced++;
+            }
+            seen[key].push_back(i);
+        }));
+        batch.push_back([&unkeyed]() { unkeyed++; });
+        if (batch.size() >= 100) {
+            executor.Submit(batch);
+            EXPECT_TRUE(batch.empty());
+        }
+    }
+    executor.Submit(batch);
+    executor.Wait();
+    EXPECT_EQ(executor.Executed(), Count * 2);
+    EXPECT_EQ(unkeyed, Count);
+    EXPECT_EQ(misplaced, 0);
+    for (int key = 0; key < Keys; key++) {
+        EXPECT_EQ((int)seen[key].size(), Count / Keys);
+        EXPECT_TRUE(std::is_sorted(seen[key].begin(), seen[key].end()));
+    }
+}
+
+TEST(TimerExecutor, DispatchFromTimer) {
+    std::shared_ptr<TimerExecutor> executor = std::make_shared<TimerExecutor>(2);
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        timer->SetExecutor(executor);
+        std::atomic<int> fired(0);
+        std::thread::id self = std::this_thread::get_id();
+        std::atomic<int> inline_fired(0);
+        for (int i = 0; i < N1; i++) {
+            timer->Start(i % 10, [&]() {
+                if (std::this_thread::get_id() == self) {
+                    inline_fired++;
+                }
+                fired++;
+            });
+        }
+        int dispatched = 0;
+        int64_t end = Clock::CurrentTimeMillis() + 1000;
+        while (dispatched < N1 && Clock::CurrentTimeMillis() < end) {
+            dispatched += timer->Update(Clock::CurrentTimeMillis());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        executor->Wait();
+        EXPECT_EQ(dispatched, N1);
+        EXPECT_EQ(fired, N1);
+        EXPECT_EQ(inline_fired, 0);
+        EXPECT_EQ(timer->Size(), 0);
+        printf("timer type %d dispatched to executor\n", type);
+    }
+}
+
+// timers started from other threads and from callbacks fire on the ticker thread, never early,
+// a timer earlier than the one waited for wakes the ticker.
+static void TestTimerThread(std::shared_ptr<TimerBase> timer, TickMode mode) {
+    const int Count = 100;
+    const int Rearmed = Count / 10;
+    TimerThread driver(timer, mode);
+    driver.Run();
+    std::atomic<int> fired(0);
+    std::atomic<int> rearm_fired(0);
+    std::atomic<int> early(0);
+    std::atomic<int> off_ticker(0);
+    std::thread::id ticker;
+    driver.Start(0, [&ticker]() { ticker = std::this_thread::get_id(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    driver.Start(60000, nullptr);
+    for (int i = 0; i < Count; i++) {
+        uint32_t delay = i % 20;
+        int64_t deadline = Clock::CurrentTimeMillis() + delay;
+        driver.Start(delay, [&, i, deadline]() {
+            if (Clock::CurrentTimeMillis() < deadline) {
+                early++;
+            }
+            if (std::this_thread::get_id() != ticker) {
+                off_ticker++;
+            }
+            if (i % 10 == 0) {
+                driver.Start(1, [&rearm_fired]() { rearm_fired++; });
+            }
+            fired++;
+        });
+    }
+    int64_t end = Clock::CurrentTimeMillis() + 2000;
+    while ((fired < Count || rearm_fired < Rearmed) && Clock::CurrentTimeMillis() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    driver.Stop();
+    EXPECT_EQ(fired, Count);
+    EXPECT_EQ(rearm_fired, Rearmed);
+    EXPECT_EQ(early, 0);
+    EXPECT_EQ(off_ticker, 0);
+    EXPECT_EQ(driver.Size(), 1);
+    TimerThreadStats stats = driver.Stats();
+    EXPECT_EQ(stats.fired, Count + Rearmed + 1);
+    int64_t total = 0;
+    for (int i = 0; i < LATENESS_BUCKETS; i++) {
+        total += stats.lateness[i];
+    }
+    EXPECT_EQ(total, stats.fired);
+}
+
+TEST(TimerThread, Sleep) {
+    TestTimerThread(std::make_shared<QuadHeapTimer>(), TickMode::Sleep);
+    TestTimerThread(std::make_shared<HybridWheelTimer>(), TickMode::Sleep); // deadline not tracked
+}
+
+TEST(TimerThread, Hybrid) {
+    TestTimerThread(std::make_shared<DAryHeapTimer<4>>(), TickMode::Hybrid);
+}
+
+TEST(TimerThread, BusyPoll) {
+    TestTimerThread(std::make_shared<PriorityQueueTimer>(), TickMode::BusyPoll);
+}
+
+#if defined(__linux__)
+
+static void TestEventLoopTimers(std::shared_ptr<TimerBase> timer, LoopTimerMode mode) {
+    const int Count = 100;
+    EventLoop loop(timer, mode);
+    std::atomic<int> fired(0);
+    std::atomic<int> early(0);
+    for (int i = 0; i < Count; i++) {
+        uint32_t delay = 1 + i % 10;
+        int64_t deadline = Clock::CurrentTimeMillis() + delay;
+        loop.Start(delay, [&, deadline]() {
+            if (Clock::CurrentTimeMillis() < deadline) {
+                early++;
+            }
+            fired++;
+        });
+    }
+    int canceled = loop.Start(5, [&]() { fired++; });
+    EXPECT_TRUE(loop.Cancel(canceled));
+    int64_t end = Clock::CurrentTimeMillis() + 2000;
+    while (fired < Count && Clock::CurrentTimeMillis() < end) {
+        loop.RunOnce(100);
+    }
+    EXPECT_EQ(fired, Count);
+    EXPECT_EQ(early, 0);
+    EXPECT_EQ(loop.Size(), 0);
+    EventLoopStats stats = loop.Stats();
+    EXPECT_EQ(stats.fired, Count);
+    if (mode == LoopTimerMode::TimerFd) {
+        // armed once per distinct head deadline, not once per timer
+        EXPECT_LE(stats.arms, 15);
+    } else {
+        EXPECT_EQ(stats.arms, 0);
+    }
+}
+
+TEST(EventLoop, TimerFd) {
+    TestEventLoopTimers(std::make_shared<QuadHeapTimer>(), LoopTimerMode::TimerFd);
+    TestEventLoopTimers(std::make_shared<DAryHeapTimer<4>>(), LoopTimerMode::TimerFd);
+}
+
+TEST(EventLoop, WaitTimeout) {
+    TestEventLoopTimers(std::make_shared<QuadHeapTimer>(), LoopTimerMode::WaitTimeout);
+    TestEventLoopTimers(std::make_shared<HybridWheelTimer>(), LoopTimerMode::WaitTimeout);
+}
+
+TEST(EventLoop, PostAndStop) {
+    const int Threads = 4;
+    const int Count = 1000;
+    EventLoop loop(std::make_shared<QuadHeapTimer>());
+    std::atomic<int> fired(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < Count; i++) {
+                loop.Post([&]() {
+                    loop.Start(1, [&]() {
+                        if (++fired == Threads * Count) {
+                            loop.Stop();
+                        }
+                    });
+                });
+            }
+        });
+    }
+    loop.Run();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(fired, Threads * Count);
+    EventLoopStats stats = loop.Stats();
+    EXPECT_GE(stats.posted, Threads * Count);
+    // one eventfd write per batch drained by the loop
+    EXPECT_LE(stats.writes, stats.posted + 1);
+}
+
+TEST(EventLoop, PipeReadable) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    EventLoop loop(std::make_shared<QuadHeapTimer>());
+    std::string received;
+    ASSERT_TRUE(loop.AddFd(fds[0], EPOLLIN, [&](uint32_t events) {
+        EXPECT_TRUE(events & EPOLLIN);
+        char buf[16];
+        ssize_t n = read(fds[0], buf, sizeof(buf));
+        if (n > 0) {
+            received.append(buf, n);
+        }
+    }));
+    loop.Start(2, [&]() {
+        ssize_t n = write(fds[1], "ping", 4);
+        (void)n;
+    });
+    int64_t end = Clock::CurrentTimeMillis() + 1000;
+    while (received.empty() && Clock::CurrentTimeMillis() < end) {
+        loop.RunOnce(100);
+    }
+    EXPECT_EQ(received, "ping");
+    EXPECT_TRUE(loop.RemoveFd(fds[0]));
+    EXPECT_FALSE(loop.RemoveFd(fds[0]));
+    close(fds[0]);
+    close(fds[1]);
+}
+
+#endif // __linux__
+
+#if defined(__cpp_impl_coroutine)
+
+template <typename Timer>
+static Task<int64_t> sleepFor(Timer& timer, uint32_t duration) {
+    int64_t deadline = Clock::CurrentTimeMillis() + duration;
+    co_await Sleep(timer, duration);
+    co_return Clock::CurrentTimeMillis() - deadline;
+}
+
+template <typename Timer>
+static Task<> sleepCount(Timer& timer, int times, int* count) {
+    for (int i = 0; i < times; i++) {
+        co_await Sleep(timer, 1 + i % 3);
+        (*count)++;
+    }
+}
+
+template <typename Timer, typename T>
+static void runUntilDone(Timer& timer, Task<T>& task) {
+    int64_t end = Clock::CurrentTimeMillis() + 1000;
+    while (!task.Done() && Clock::CurrentTimeMillis() < end) {
+        timer.Update(Clock::CurrentTimeMillis());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST(Coroutine, Sleep) {
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        Task<int64_t> task = sleepFor(*timer, 5);
+        task.Start();
+        EXPECT_FALSE(task.Done());
+        runUntilDone(*timer, task);
+        ASSERT_TRUE(task.Done());
+        EXPECT_GE(task.Result(), 0);
+
+        int count = 0;
+        Task<> loop = sleepCount(*timer, 10, &count);
+        loop.Start();
+        runUntilDone(*timer, loop);
+        EXPECT_EQ(count, 10);
+        printf("timer type %d resumed coroutines\n", type);
+    }
+}
+
+TEST(Coroutine, IntrusiveSleep) {
+    IntrusiveRBTreeTimer timer;
+    Task<int64_t> task = sleepFor(timer, 5);
+    task.Start();
+    EXPECT_EQ(timer.Size(), 1);
+    runUntilDone(timer, task);
+    ASSERT_TRUE(task.Done());
+    EXPECT_GE(task.Result(), 0);
+    EXPECT_EQ(timer.Size(), 0);
+}
+
+TEST(Coroutine, CancelOnDestroy) {
+    int count = 0;
+    IntrusiveRBTreeTimer intrusive;
+    {
+        Task<> task = sleepCount(intrusive, 10, &count);
+        task.Start();
+        EXPECT_EQ(intrusive.Size(), 1);
+    }
+    EXPECT_EQ(intrusive.Size(), 0);
+
+    for (int type = 1; type <= 15; type++) {
+        auto timer = CreateTimer((TimerSchedType)type);
+        {
+            Task<> task = sleepCount(*timer, 10, &count);
+            task.Start();
+        }
+        timer->Update(Clock::CurrentTimeMillis() + 10);
+        EXPECT_EQ(timer->Size(), 0);
+    }
+    EXPECT_EQ(count, 0);
+}
+
+template <typename Timer>
+static Task<> raceSleep(Timer& timer, uint32_t work, uint32_t timeout, std::optional<int64_t>* out) {
+    *out = co_await WithTimeout(timer, sleepFor(timer, work), timeout);
+}
+
+TEST(Coroutine, WithTimeout) {
+    QuadHeapTimer timer;
+    std::optional<int64_t> result;
+    Task<> finished = raceSleep(timer, 2, 50, &result);
+    finished.Start();
+    runUntilDone(timer, finished);
+    ASSERT_TRUE(finished.Done());
+    EXPECT_TRUE(result.has_value());
+    EXPECT_EQ(timer.Size(), 0);   // timeout timer canceled
+
+    result = 0;
+    Task<> timed_out = raceSleep(timer, 100, 2, &result);
+    timed_out.Start();
+    runUntilDone(timer, timed_out);
+    ASSERT_TRUE(timed_out.Done());
+    EXPECT_FALSE(result.has_value());
+    EXPECT_EQ(timer.Size(), 0);   // sleep of destroyed task canceled
+}
+
+#endif // __cpp_impl_coroutine